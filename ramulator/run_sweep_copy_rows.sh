@@ -1,14 +1,14 @@
 #!/bin/bash
 
 OUT_DIR="./out"
-WORKLOAD="./workloads/401.bzip2"
-
-if [ ! -f $WORKLOAD ]; then
-    gzip -d $WORKLOAD.gz -c > $WORKLOAD
-fi
+# compressed traces are decompressed on the fly by ramulator
+WORKLOAD="./workloads/401.bzip2.gz"
 
 mkdir -p $OUT_DIR
 
+# copy_rows_per_SA sizes the CROW table during the warmup too (-p), so each
+# configuration warms up on its own rather than from a shared checkpoint or
+# sweep (-c), which would warm every point up with the config's 8 copy rows
 
 COPY_ROWS_PER_SA=1
 while [ $COPY_ROWS_PER_SA -le 128 ]; do
@@ -18,7 +18,7 @@ while [ $COPY_ROWS_PER_SA -le 128 ]; do
     ./ramulator ./configs/CROW_configs/LPDDR4.cfg --mode=cpu \
         -t $WORKLOAD -p warmup_insts=50000000 -p expected_limit_insts=100000000 \
         -p weak_rows_per_SA=0 -p copy_rows_per_SA=$COPY_ROWS_PER_SA \
-        --stats $OUT_DIR/$(basename ${WORKLOAD})-${COPY_ROWS_PER_SA}-copyrows.out
+        --stats $OUT_DIR/$(basename ${WORKLOAD} .gz)-${COPY_ROWS_PER_SA}-copyrows.out
 
     let COPY_ROWS_PER_SA=COPY_ROWS_PER_SA*2
 done
@@ -115,12 +115,12 @@ public:
     };
 
     /* Prerequisite */
-    function<Command(DRAM<ALDRAM>*, Command cmd, int)> prereq[int(Level::MAX)][int(Command::MAX)];
+    Command (*prereq[int(Level::MAX)][int(Command::MAX)])(DRAM<ALDRAM>*, Command cmd, int) = {};
 
     // SAUGATA: added function object container for row hit status
     /* Row hit */
-    function<bool(DRAM<ALDRAM>*, Command cmd, int)> rowhit[int(Level::MAX)][int(Command::MAX)];
-    function<bool(DRAM<ALDRAM>*, Command cmd, int)> rowopen[int(Level::MAX)][int(Command::MAX)];
+    bool (*rowhit[int(Level::MAX)][int(Command::MAX)])(DRAM<ALDRAM>*, Command cmd, int) = {};
+    bool (*rowopen[int(Level::MAX)][int(Command::MAX)])(DRAM<ALDRAM>*, Command cmd, int) = {};
 
     /* Timing */
     struct TimingEntry
@@ -133,7 +133,7 @@ public:
     vector<TimingEntry> timing[int(Level::MAX)][int(Command::MAX)];
 
     /* Lambda */
-    function<void(DRAM<ALDRAM>*, int)> lambda[int(Level::MAX)][int(Command::MAX)];
+    void (*lambda[int(Level::MAX)][int(Command::MAX)])(DRAM<ALDRAM>*, int) = {};
 
     /* Organization */
     enum class Org : int
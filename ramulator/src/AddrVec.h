@@ -0,0 +1,68 @@
+#ifndef __ADDRVEC_H
+#define __ADDRVEC_H
+
+#include <algorithm>
+#include <cassert>
+
+namespace ramulator
+{
+
+/* An address decomposed into one index per DRAM level (T::Level), stored
+ * inline instead of in a heap-allocated vector<int>. Supports the subset of
+ * the vector interface used on addresses. CAPACITY bounds T::Level::MAX of
+ * every standard, which DRAM<T> checks at compile time. */
+class AddrVec
+{
+public:
+    static const int CAPACITY = 8;
+
+    typedef int value_type;
+    typedef int* iterator;
+    typedef const int* const_iterator;
+
+    AddrVec() {}
+    explicit AddrVec(int n, int val = 0) { resize(n, val); }
+    AddrVec(const int* first, const int* last) : len(last - first)
+    {
+        assert(len <= CAPACITY);
+        std::copy(first, last, v);
+    }
+
+    int size() const { return len; }
+    bool empty() const { return len == 0; }
+    void clear() { len = 0; }
+    void resize(int n, int val = 0)
+    {
+        assert(n <= CAPACITY);
+        for (int i = len; i < n; i++)
+            v[i] = val;
+        len = n;
+    }
+
+    int* data() { return v; }
+    const int* data() const { return v; }
+    iterator begin() { return v; }
+    iterator end() { return v + len; }
+    const_iterator begin() const { return v; }
+    const_iterator end() const { return v + len; }
+    int& operator[](int i) { return v[i]; }
+    const int& operator[](int i) const { return v[i]; }
+
+    bool operator==(const AddrVec& other) const
+    {
+        return len == other.len && std::equal(v, v + len, other.v);
+    }
+    bool operator!=(const AddrVec& other) const { return !(*this == other); }
+    bool operator<(const AddrVec& other) const
+    {
+        return std::lexicographical_compare(v, v + len, other.v, other.v + other.len);
+    }
+
+private:
+    int v[CAPACITY];
+    int len = 0;
+};
+
+} /*namespace ramulator*/
+
+#endif /*__ADDRVEC_H*/
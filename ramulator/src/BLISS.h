@@ -19,7 +19,7 @@ class BLISS : public SchedulerBase<T>{
 public:
     Controller<T>* ctrl;
 
-    typedef list<Request>::iterator ReqIter;
+    typedef RequestQueue::iterator ReqIter;
     BLISS(Controller<T>* ctrl) : ctrl(ctrl) {
         bliss_shuffle_cycles = 10000;
         bliss_row_hit_cap = 4;
@@ -32,6 +32,7 @@ public:
     void Tick();
     void clear_marking();
     void issue_req(Request *req);
+    void checkpoint(Checkpoint& cp);
 
 private:
     int bliss_shuffle_cycles;
@@ -110,5 +111,13 @@ void BLISS<T>::issue_req(Request *req){
     _lastReqPid = req->coreid;
 }
 
+template <typename T>
+void BLISS<T>::checkpoint(Checkpoint& cp){
+    cp.io(_shuffleCyclesLeft);
+    cp.io(_lastReqPid);
+    cp.io(_oldestStreakGlobal);
+    cp.io(_mark);
+}
+
 }/*namespace ramulator*/
 #endif // BLISS_H
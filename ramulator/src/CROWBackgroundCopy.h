@@ -0,0 +1,137 @@
+#ifndef __H_CROW_BACKGROUND_COPY_H__
+#define __H_CROW_BACKGROUND_COPY_H__
+
+#include <string>
+#include <vector>
+#include "AddrVec.h"
+#include "Statistics.h"
+
+using namespace std;
+
+namespace ramulator {
+
+    /* State of the proactive CROW copy mode (crow_background_copy). In this
+     * mode the demand activations that miss in the CROW table do not copy
+     * the row, so they do not pay the longer tRAS of a copy. Instead, each
+     * set (subarray) counts the activations of the rows it does not hold in
+     * a small space-saving table, and once a row has been activated
+     * hot_threshold times, it becomes the copy candidate of its bank. The
+     * controller copies it when the bank has nothing else to do (see
+     * Controller::issue_background_copy()) and precharges the bank again
+     * afterwards. */
+    class CROWBackgroundCopy {
+    public:
+        static const int ROWS_PER_SET = 4; // rows counted per set
+
+        CROWBackgroundCopy(int channel_id, int num_sets, int num_banks, int hot_threshold) :
+                opened(num_banks, false), opened_addr_vecs(num_banks),
+                hot_rows(num_sets*ROWS_PER_SET), candidates(num_banks),
+                has_candidate(num_banks, false), hot_threshold(hot_threshold) {
+            crow_bg_copies
+                .name("crow_bg_copies_channel_"+to_string(channel_id) + "_core")
+                .desc("Number of rows copied in the background, while their bank was idle.")
+                .precision(0)
+                ;
+            crow_bg_copy_no_victim
+                .name("crow_bg_copy_no_victim_channel_"+to_string(channel_id) + "_core")
+                .desc("Number of background copies dropped as all copy rows of the set were above the hit threshold.")
+                .precision(0)
+                ;
+            crow_bg_copy_victim_fr
+                .name("crow_bg_copy_victim_fr_channel_"+to_string(channel_id) + "_core")
+                .desc("Number of background copies dropped as the victim needed a full restore.")
+                .precision(0)
+                ;
+            crow_bg_copy_victim_hit
+                .name("crow_bg_copy_victim_hit_channel_"+to_string(channel_id) + "_core")
+                .desc("Number of background copies dropped as the victim was hit recently.")
+                .precision(0)
+                ;
+            crow_bg_copy_rejected
+                .name("crow_bg_copy_rejected_channel_"+to_string(channel_id) + "_core")
+                .desc("Number of background copies dropped as the replacement policy did not admit the row.")
+                .precision(0)
+                ;
+        }
+
+        // A demand activation of a row that is not in the CROW table
+        void record(int set, int bank, const AddrVec& addr_vec, int row) {
+            HotRow* rows = &hot_rows[set*ROWS_PER_SET];
+
+            // space-saving: a new row replaces the least counted one and
+            // inherits its count
+            HotRow* hot = nullptr;
+            HotRow* least = rows;
+            for(int i = 0; i < ROWS_PER_SET; i++) {
+                if(rows[i].count > 0 && rows[i].row == row) {
+                    hot = &rows[i];
+                    break;
+                }
+                if(rows[i].count < least->count)
+                    least = &rows[i];
+            }
+            if(hot == nullptr) {
+                hot = least;
+                hot->row = row;
+            }
+            hot->count++;
+
+            if(hot->count >= hot_threshold &&
+                    (!has_candidate[bank] || hot->count > candidates[bank].count)) {
+                candidates[bank].addr_vec = addr_vec;
+                candidates[bank].set = set;
+                candidates[bank].count = hot->count;
+                has_candidate[bank] = true;
+            }
+        }
+
+        bool get_candidate(int bank, AddrVec& addr_vec) const {
+            if(has_candidate[bank])
+                addr_vec = candidates[bank].addr_vec;
+            return has_candidate[bank];
+        }
+
+        // The candidate of the bank was copied (or found in the table), or
+        // dropped
+        void clear_candidate(int bank, int row) {
+            has_candidate[bank] = false;
+
+            HotRow* rows = &hot_rows[candidates[bank].set*ROWS_PER_SET];
+            for(int i = 0; i < ROWS_PER_SET; i++) {
+                if(rows[i].row == row)
+                    rows[i].count = 0;
+            }
+        }
+
+        // Banks left open by a background copy, to precharge when idle
+        vector<bool> opened;
+        vector<AddrVec> opened_addr_vecs;
+
+        ScalarStat crow_bg_copies;
+        // the candidates dropped, by reason
+        ScalarStat crow_bg_copy_no_victim;
+        ScalarStat crow_bg_copy_victim_fr;
+        ScalarStat crow_bg_copy_victim_hit;
+        ScalarStat crow_bg_copy_rejected;
+
+    private:
+        struct HotRow {
+            int row = 0;
+            int count = 0;
+        };
+
+        struct Candidate {
+            AddrVec addr_vec;
+            int set = 0;
+            int count = 0;
+        };
+
+        vector<HotRow> hot_rows;
+        vector<Candidate> candidates;
+        vector<bool> has_candidate;
+        int hot_threshold;
+    };
+
+} // namespace ramulator
+
+#endif //__H_CROW_BACKGROUND_COPY_H__
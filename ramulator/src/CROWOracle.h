@@ -0,0 +1,131 @@
+#ifndef __H_CROW_ORACLE_H__
+#define __H_CROW_ORACLE_H__
+
+#include <cassert>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Statistics.h"
+
+using namespace std;
+
+namespace ramulator {
+
+    /* Offline upper bound on the hit rate of any CROW table replacement
+     * policy (crow_oracle). The first pass records, during the simulation,
+     * the row of every demand activation in each CROW table set (the
+     * activations issued only to fully restore a row before evicting it are
+     * not demand ones). The second pass, in finish(), replays each set's
+     * stream against a table of the same capacity that knows the future:
+     * Belady's MIN, which on a miss evicts the row that is used again the
+     * furthest in the future, or does not copy the new row if that is the
+     * new row itself.
+     *
+     * The replay ignores timing, so it bounds the hits of the recorded
+     * stream; a better policy could change the stream itself (e.g., the
+     * row buffer hits) only through timing. */
+    class CROWOracle {
+    public:
+        CROWOracle(int channel_id, int num_sets, int capacity) :
+                streams(num_sets), capacity(capacity) {
+            crow_oracle_hits
+                .name("crow_oracle_hits_channel_"+to_string(channel_id) + "_core")
+                .desc("Number of CROW table hits (comparable to crow_num_hits) with Belady-optimal replacement.")
+                .precision(0)
+                ;
+            crow_oracle_hit_rate
+                .name("crow_oracle_hit_rate_channel_"+to_string(channel_id) + "_core")
+                .desc("CROW table hit rate with Belady-optimal replacement.")
+                .precision(6)
+                ;
+        }
+
+        void record(int set, int row) {
+            streams[set].push_back(row);
+        }
+
+        void finish() {
+            long hits = 0, accesses = 0;
+            for(auto& stream : streams) {
+                hits += replay(stream);
+                accesses += stream.size();
+            }
+
+            crow_oracle_hits = hits;
+            crow_oracle_hit_rate = accesses ? double(hits)/accesses : 0.0;
+        }
+
+    private:
+        vector<vector<int>> streams;
+        int capacity;
+
+        ScalarStat crow_oracle_hits;
+        ScalarStat crow_oracle_hit_rate;
+
+        static const long NEVER = 1L << 62;
+
+        long replay(const vector<int>& stream) const {
+            if(capacity <= 0)
+                return 0;
+
+            // the position of the next access to the same row, for each
+            // access
+            vector<long> next_use(stream.size());
+            unordered_map<int, long> last_seen;
+            for(long i = long(stream.size()) - 1; i >= 0; i--) {
+                auto it = last_seen.find(stream[i]);
+                next_use[i] = (it == last_seen.end()) ? NEVER : it->second;
+                last_seen[stream[i]] = i;
+            }
+
+            // the copy rows, with the next use of the row each holds; a set
+            // has few enough of them for linear scans
+            vector<int> rows;
+            vector<long> uses;
+            rows.reserve(capacity);
+            uses.reserve(capacity);
+
+            long hits = 0;
+            for(size_t i = 0; i < stream.size(); i++) {
+                int way = -1;
+                for(size_t j = 0; j < rows.size(); j++) {
+                    if(rows[j] == stream[i]) {
+                        way = j;
+                        break;
+                    }
+                }
+
+                if(way != -1) {
+                    hits++;
+                    uses[way] = next_use[i];
+                    continue;
+                }
+
+                if(next_use[i] == NEVER)
+                    continue;
+
+                if(int(rows.size()) < capacity) {
+                    rows.push_back(stream[i]);
+                    uses.push_back(next_use[i]);
+                    continue;
+                }
+
+                int victim = 0;
+                for(size_t j = 1; j < uses.size(); j++) {
+                    if(uses[j] > uses[victim])
+                        victim = j;
+                }
+
+                if(uses[victim] > next_use[i]) {
+                    rows[victim] = stream[i];
+                    uses[victim] = next_use[i];
+                }
+            }
+
+            return hits;
+        }
+    };
+
+} // namespace ramulator
+
+#endif //__H_CROW_ORACLE_H__
@@ -0,0 +1,103 @@
+#include "CROWReplacement.h"
+
+using namespace ramulator;
+
+CROWReplacement* CROWReplacement::create(const string& name, int crow_id, int num_sets,
+        int ways, float to_mru_frac)
+{
+    if (name == "LRU")
+        return new CROWLRU(num_sets, ways, to_mru_frac);
+    if (name == "SRRIP")
+        return new CROWSRRIP(crow_id, num_sets, ways);
+    if (name == "LFU")
+        return new CROWLFU(crow_id, num_sets, ways);
+    if (name == "TinyLFU")
+        return new CROWTinyLFU(crow_id, num_sets, ways, to_mru_frac);
+
+    assert(false && "Unknown crow_replacement policy (LRU, SRRIP, LFU or TinyLFU)");
+    return nullptr;
+}
+
+int CROWLRU::get_victim(int set, const CROWEntry* set_entries, int hit_threshold)
+{
+    // the least recently used entry with few enough hits
+    int victim = -1;
+    int victim_rank = -1;
+    for (int i = 0; i < ways; i++) {
+        int r = rank(set, i);
+        if (r > victim_rank && (hit_threshold == 0 ||
+                    set_entries[i].hit_count <= hit_threshold)) {
+            victim = i;
+            victim_rank = r;
+        }
+    }
+
+    return victim;
+}
+
+int CROWSRRIP::get_victim(int set, const CROWEntry* set_entries, int hit_threshold)
+{
+    int* set_rrpvs = &rrpvs[set*ways];
+    auto eligible = [&](int i) {
+        return set_entries[i].valid && !set_entries[i].is_to_remap_weak_row &&
+            (hit_threshold == 0 || set_entries[i].hit_count <= hit_threshold);
+    };
+
+    int max_rrpv = -1;
+    for (int i = 0; i < ways; i++) {
+        if (eligible(i))
+            max_rrpv = max(max_rrpv, set_rrpvs[i]);
+    }
+    if (max_rrpv == -1)
+        return -1;
+
+    // The first eligible entry to reach MAX_RRPV as SRRIP ages the set,
+    // which make_victim() does
+    for (int i = 0; i < ways; i++) {
+        if (eligible(i) && set_rrpvs[i] == max_rrpv)
+            return i;
+    }
+
+    assert(false);
+    return -1;
+}
+
+void CROWSRRIP::make_victim(int set, int way)
+{
+    // Age the whole set at once by as many steps as SRRIP would take until
+    // the victim reaches MAX_RRPV. The RRPVs of the invalid entries and
+    // of the remapped weak rows are not read before they are set again.
+    int* set_rrpvs = &rrpvs[set*ways];
+    if (set_rrpvs[way] < MAX_RRPV) {
+        int steps = MAX_RRPV - set_rrpvs[way];
+        for (int i = 0; i < ways; i++)
+            set_rrpvs[i] = min(set_rrpvs[i] + steps, MAX_RRPV);
+        crow_srrip_agings += steps;
+    }
+
+    // above MAX_RRPV, so that it wins over the other distant rows
+    set_rrpvs[way] = MAX_RRPV + 1;
+}
+
+int CROWLFU::get_victim(int set, const CROWEntry* set_entries, int hit_threshold)
+{
+    int victim = forced[set];
+
+    if (victim == -1 || (hit_threshold != 0 &&
+                set_entries[victim].hit_count > hit_threshold)) {
+        // the least frequently hit entry, the least recently used one among
+        // those with the same hit count
+        victim = -1;
+        for (int i = 0; i < ways; i++) {
+            int r = rank(set, i);
+            if (r < 0 || (hit_threshold != 0 && set_entries[i].hit_count > hit_threshold))
+                continue;
+            if (victim == -1 || set_entries[i].hit_count < set_entries[victim].hit_count ||
+                    (set_entries[i].hit_count == set_entries[victim].hit_count &&
+                     r > rank(set, victim)))
+                victim = i;
+        }
+    }
+
+    return victim;
+}
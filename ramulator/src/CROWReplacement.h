@@ -0,0 +1,403 @@
+#ifndef __H_CROW_REPLACEMENT_H__
+#define __H_CROW_REPLACEMENT_H__
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "Checkpoint.h"
+#include "Statistics.h"
+
+using namespace std;
+
+namespace ramulator {
+
+    class CROWEntry {
+        public:
+            ulong row_addr;
+            bool valid;
+            bool FR; //Force Restoration
+            int hit_count;
+            long total_hits; // used only for statistic collection
+            bool is_to_remap_weak_row;
+
+            CROWEntry() {
+                row_addr = 0;
+                valid = false;
+                FR = false;
+                hit_count = 0;
+                total_hits = 0;
+                is_to_remap_weak_row = false;
+            }
+    };
+
+    /* Replacement policy of a CROWTable. The table is split into sets (one per
+     * subarray, or group of subarrays) of 'ways' copy rows each. A policy only
+     * tracks the entries that hold a copy of a regular row, i.e., the valid
+     * ones that are not remapped weak rows. Ways are indices within a set. */
+    class CROWReplacement {
+    public:
+        CROWReplacement(int num_sets, int ways) : num_sets(num_sets), ways(ways) {}
+        virtual ~CROWReplacement() {}
+
+        static CROWReplacement* create(const string& name, int crow_id, int num_sets,
+                int ways, float to_mru_frac);
+
+        // Every activation of a row mapped to the set, before the table
+        // changes for it
+        virtual void on_access(int set, int row) {}
+
+        // An activation hit the row in 'way'. to_LRU is set when the row was
+        // only activated to fully restore it before evicting it (which is not
+        // passed to on_access()).
+        virtual void on_hit(int set, int way, bool to_LRU) = 0;
+
+        // A new row was copied into 'way'. If defer is set, the policy must
+        // not call rand() here but in finish_insert() (see
+        // CROWTable::defer_insertion).
+        virtual void on_insert(int set, int way, bool defer) = 0;
+        virtual void finish_insert() {}
+
+        // The row in 'way' was invalidated, or evicted for a new row
+        virtual void on_remove(int set, int way) = 0;
+        virtual void on_evict(int set, int way, const CROWEntry& entry) { on_remove(set, way); }
+
+        // The way whose row should be evicted next among those whose
+        // hit_count is at most hit_threshold (all if 0), or -1 if none is.
+        // Only a query, which may be repeated for the same miss or not be
+        // followed by an eviction: the policy changes its state for the
+        // victim in make_victim() or on_hit() with to_LRU.
+        virtual int get_victim(int set, const CROWEntry* set_entries, int hit_threshold) = 0;
+
+        // Make get_victim() return 'way' until it is hit or removed
+        virtual void make_victim(int set, int way) = 0;
+
+        // Whether a row missing in the table should replace the victim's
+        // row rather than be activated without being copied. A rejected row
+        // is never copied, while an admitted one may still not be (see
+        // on_evict()).
+        virtual bool admit(int set, int row, int victim_row) { return true; }
+
+        virtual void checkpoint(Checkpoint& cp) = 0;
+
+    protected:
+        int num_sets;
+        int ways;
+    };
+
+
+    /* Least recently used, with a fraction (to_mru_frac) of the new rows
+     * inserted at the MRU position and the rest at the LRU position. Each
+     * entry has its recency rank within its set (0 is the most recently
+     * used, -1 if not tracked); a set's ranks are contiguous, so the updates
+     * are short scans without any allocation. */
+    class CROWLRU : public CROWReplacement {
+    public:
+        CROWLRU(int num_sets, int ways, float to_mru_frac) :
+                CROWReplacement(num_sets, ways), to_mru_frac(to_mru_frac) {
+            ranks = new int[num_sets*ways];
+            fill(ranks, ranks + num_sets*ways, -1);
+            sizes = new int[num_sets];
+            fill(sizes, sizes + num_sets, 0);
+        }
+
+        ~CROWLRU() {
+            delete[] ranks;
+            delete[] sizes;
+        }
+
+        void on_hit(int set, int way, bool to_LRU) {
+            erase(set, way);
+            if(!to_LRU)
+                push_front(set, way);
+            else
+                push_back(set, way);
+        }
+
+        void on_insert(int set, int way, bool defer) {
+            assert(sizes[set] < ways && "The set cannot hold another row!");
+
+            if(defer) {
+                push_back(set, way);
+                deferred_set = set;
+                deferred_way = way;
+                return;
+            }
+
+            float r = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+
+            if(r >= to_mru_frac)
+                push_back(set, way);
+            else
+                push_front(set, way);
+        }
+
+        // Draws the random number on_insert() skipped and moves the new
+        // entry to the MRU position if needed
+        void finish_insert() {
+            if(deferred_set == -1)
+                return;
+
+            float r = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+
+            if(r < to_mru_frac){
+                erase(deferred_set, deferred_way);
+                push_front(deferred_set, deferred_way);
+            }
+
+            deferred_set = -1;
+        }
+
+        void on_remove(int set, int way) {
+            erase(set, way);
+        }
+
+        int get_victim(int set, const CROWEntry* set_entries, int hit_threshold);
+
+        void make_victim(int set, int way) {
+            erase(set, way);
+            push_back(set, way);
+        }
+
+        void checkpoint(Checkpoint& cp) {
+            cp.io(ranks, num_sets*ways);
+            cp.io(sizes, num_sets);
+            cp.io(deferred_set);
+            cp.io(deferred_way);
+        }
+
+    protected:
+        int* ranks;
+        int* sizes;
+        float to_mru_frac;
+
+        int deferred_set = -1;
+        int deferred_way = 0;
+
+        int rank(int set, int way) const { return ranks[set*ways + way]; }
+
+        void push_front(int set, int way) {
+            int* set_ranks = ranks + set*ways;
+            for(int i = 0; i < ways; i++) {
+                if(set_ranks[i] >= 0)
+                    set_ranks[i]++;
+            }
+            set_ranks[way] = 0;
+            sizes[set]++;
+        }
+
+        void push_back(int set, int way) {
+            ranks[set*ways + way] = sizes[set]++;
+        }
+
+        void erase(int set, int way) {
+            int* set_ranks = ranks + set*ways;
+            int r = set_ranks[way];
+            assert(r >= 0);
+            for(int i = 0; i < ways; i++) {
+                if(set_ranks[i] > r)
+                    set_ranks[i]--;
+            }
+            set_ranks[way] = -1;
+            sizes[set]--;
+        }
+    };
+
+
+    /* Static re-reference interval prediction (SRRIP-HP, Jaleel et al.,
+     * ISCA 2010) with 2-bit RRPVs. New rows are predicted to be re-referenced
+     * in a long interval, so a stream of rows that are never hit replaces
+     * itself instead of the rows that are. */
+    class CROWSRRIP : public CROWReplacement {
+    public:
+        static const int MAX_RRPV = 3;
+
+        CROWSRRIP(int crow_id, int num_sets, int ways) :
+                CROWReplacement(num_sets, ways), rrpvs(num_sets*ways, 0) {
+            crow_srrip_agings
+                .name("crow_srrip_agings_"+to_string(crow_id))
+                .desc("Number of times the RRPVs of a set were incremented to find a victim")
+                .precision(0)
+                ;
+        }
+
+        void on_hit(int set, int way, bool to_LRU) {
+            if(to_LRU)
+                make_victim(set, way);
+            else
+                rrpvs[set*ways + way] = 0;
+        }
+
+        void on_insert(int set, int way, bool defer) {
+            rrpvs[set*ways + way] = MAX_RRPV - 1;
+        }
+
+        void on_remove(int set, int way) {}
+
+        int get_victim(int set, const CROWEntry* set_entries, int hit_threshold);
+
+        // Ages the set as get_victim() would have to find 'way', which
+        // happens only once the row is going to be evicted
+        void make_victim(int set, int way);
+
+        void checkpoint(Checkpoint& cp) {
+            cp.io(rrpvs);
+        }
+
+    private:
+        vector<int> rrpvs;
+
+        ScalarStat crow_srrip_agings;
+    };
+
+
+    /* Least frequently used, on the entries' hit counts, which CROWTable
+     * halves every crow_half_life accesses to a set (aging). Ties go to the
+     * least recently used entry. */
+    class CROWLFU : public CROWLRU {
+    public:
+        CROWLFU(int crow_id, int num_sets, int ways) :
+                CROWLRU(num_sets, ways, 1.0f), forced(num_sets, -1) {
+            crow_lfu_evict_hit_count
+                .name("crow_lfu_evict_hit_count_"+to_string(crow_id))
+                .desc("Sum of the (aged) hit counts of the rows chosen for eviction")
+                .precision(0)
+                ;
+        }
+
+        void on_hit(int set, int way, bool to_LRU) {
+            CROWLRU::on_hit(set, way, to_LRU);
+            forced[set] = to_LRU ? way : (forced[set] == way ? -1 : forced[set]);
+        }
+
+        void on_insert(int set, int way, bool defer) {
+            // always at the MRU position, no random draw
+            push_front(set, way);
+        }
+
+        void on_remove(int set, int way) {
+            CROWLRU::on_remove(set, way);
+            if(forced[set] == way)
+                forced[set] = -1;
+        }
+
+        void on_evict(int set, int way, const CROWEntry& entry) {
+            crow_lfu_evict_hit_count += entry.hit_count;
+            on_remove(set, way);
+        }
+
+        int get_victim(int set, const CROWEntry* set_entries, int hit_threshold);
+
+        void make_victim(int set, int way) {
+            CROWLRU::make_victim(set, way);
+            forced[set] = way;
+        }
+
+        void checkpoint(Checkpoint& cp) {
+            CROWLRU::checkpoint(cp);
+            cp.io(forced);
+        }
+
+    private:
+        vector<int> forced;
+
+        ScalarStat crow_lfu_evict_hit_count;
+    };
+
+
+    /* LRU eviction behind a TinyLFU admission filter (Einziger et al., ACM
+     * TOS 2017): a row that misses replaces the LRU victim only if it was
+     * activated at least as often recently as the victim's row. The access
+     * frequencies are estimated with a count-min sketch of 4-bit counters,
+     * which are halved after every 10 * width recorded activations. */
+    class CROWTinyLFU : public CROWLRU {
+    public:
+        static const int DEPTH = 4;
+        static const int MAX_COUNT = 15;
+
+        CROWTinyLFU(int crow_id, int num_sets, int ways, float to_mru_frac) :
+                CROWLRU(num_sets, ways, to_mru_frac) {
+            width_bits = 6;
+            while((1 << width_bits) < num_sets*ways)
+                width_bits++;
+            counters.assign(DEPTH << width_bits, 0);
+            sample_size = 10L << width_bits;
+
+            crow_tinylfu_admitted
+                .name("crow_tinylfu_admitted_"+to_string(crow_id))
+                .desc("Number of missing rows admitted into a full set")
+                .precision(0)
+                ;
+            crow_tinylfu_resets
+                .name("crow_tinylfu_resets_"+to_string(crow_id))
+                .desc("Number of times the frequency sketch was halved")
+                .precision(0)
+                ;
+        }
+
+        void on_access(int set, int row) {
+            uint64_t key = make_key(set, row);
+            for(int i = 0; i < DEPTH; i++) {
+                uint8_t& c = counters[(i << width_bits) + index(key, i)];
+                if(c < MAX_COUNT)
+                    c++;
+            }
+
+            if(++samples == sample_size) {
+                for(auto& c : counters)
+                    c >>= 1;
+                samples /= 2;
+                crow_tinylfu_resets++;
+            }
+        }
+
+        bool admit(int set, int row, int victim_row) {
+            // the candidate's current activation is not recorded yet, hence >=
+            return estimate(make_key(set, row)) >= estimate(make_key(set, victim_row));
+        }
+
+        // Admissions are counted when the victim is actually replaced, as
+        // the table may check a miss again or drop the copy it admitted
+        void on_evict(int set, int way, const CROWEntry& entry) {
+            crow_tinylfu_admitted++;
+            CROWLRU::on_evict(set, way, entry);
+        }
+
+        void checkpoint(Checkpoint& cp) {
+            CROWLRU::checkpoint(cp);
+            cp.io(counters);
+            cp.io(samples);
+        }
+
+    private:
+        vector<uint8_t> counters;
+        int width_bits;
+        long samples = 0;
+        long sample_size;
+
+        ScalarStat crow_tinylfu_admitted;
+        ScalarStat crow_tinylfu_resets;
+
+        static uint64_t make_key(int set, int row) {
+            return (uint64_t(uint32_t(set)) << 32) | uint32_t(row);
+        }
+
+        int index(uint64_t key, int i) const {
+            key = (key + uint64_t(i + 1) * 0x9E3779B97F4A7C15ULL) * 0xFF51AFD7ED558CCDULL;
+            key ^= key >> 33;
+            return int(key >> (64 - width_bits));
+        }
+
+        int estimate(uint64_t key) const {
+            int count = MAX_COUNT;
+            for(int i = 0; i < DEPTH; i++)
+                count = min(count, int(counters[(i << width_bits) + index(key, i)]));
+            return count;
+        }
+    };
+
+} // namespace ramulator
+
+#endif //__H_CROW_REPLACEMENT_H__
@@ -1,35 +1,19 @@
 #ifndef __H_CROW_TABLE_H__
 #define __H_CROW_TABLE_H__
 
-#include <unordered_map>
-#include <list>
 #include <cstdlib>
 #include <ctime>
 #include "Statistics.h"
+#include "CROWReplacement.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
 namespace ramulator {
 
-    class CROWEntry {
-        public:
-            ulong row_addr;
-            bool valid;
-            bool FR; //Force Restoration
-            int hit_count;
-            long total_hits; // used only for statistic collection
-            bool is_to_remap_weak_row;
-
-            CROWEntry() {
-                row_addr = 0;
-                valid = false;
-                FR = false;
-                hit_count = 0;
-                total_hits = 0;
-                is_to_remap_weak_row = false;
-            }
-    };
-
     template <typename T>
     class CROWTable {
 
@@ -45,11 +29,17 @@ namespace ramulator {
 
         bool is_DDR4 = false, is_LPDDR4 = false;
 
+        // When set, add_entry() does not let the replacement policy call
+        // rand() and finish_add_entry() must be called later from the main
+        // thread. This keeps the global random sequence identical to a
+        // serial run when the controllers are ticked by multiple threads.
+        bool defer_insertion = false;
+
         CROWTable(const T* spec, const int crow_id, const uint num_SAs, 
                     const uint num_copy_rows, const uint num_weak_rows, 
                     const uint crow_evict_hit_thresh,
                     const uint crow_half_life, const float to_mru_frac,
-                    const uint num_grouped_SAs) : 
+                    const uint num_grouped_SAs, const string& replacement = "LRU") : 
                         spec(spec), crow_id(crow_id), num_SAs(num_SAs), num_copy_rows(num_copy_rows),
                         num_weak_rows(num_weak_rows), to_mru_frac(to_mru_frac), num_grouped_SAs(num_grouped_SAs) {
                     // num_grouped_SAs indicates how many consecutively
@@ -77,9 +67,10 @@ namespace ramulator {
 
 
             entries = new CROWEntry[num_entries];
-            lru_lists = new list<CROWEntry*>[num_entries/num_copy_rows];
-            pointer_maps = new unordered_map<CROWEntry*, 
-                         list<CROWEntry*>::iterator>[num_entries/num_copy_rows];
+            tags = new int[num_entries];
+            fill(tags, tags + num_entries, NO_TAG);
+            policy = CROWReplacement::create(replacement, crow_id,
+                    num_entries/num_copy_rows, num_copy_rows, to_mru_frac);
 
             cur_accesses = new int[num_entries/num_copy_rows];
             fill(cur_accesses, cur_accesses + (num_entries/num_copy_rows), 0);
@@ -143,29 +134,42 @@ namespace ramulator {
 
         virtual ~CROWTable() {
             delete[] entries;
+            delete[] tags;
             delete[] next_copy_row_id;
             delete[] sizes;
 
-            delete[] lru_lists;
-            delete[] pointer_maps;
+            delete policy;
             delete[] cur_accesses;
         }
 
-        bool access(const vector<int>& addr_vec, const bool move_to_LRU = false) {
+        void checkpoint(Checkpoint& cp) {
+            cp.check(num_entries, "CROW table size");
+            cp.io(entries, num_entries);
+            cp.io(tags, num_entries);
+            cp.io(cur_accesses, num_entries/num_copy_rows);
+            cp.io(next_copy_row_id, num_entries/num_copy_rows);
+            policy->checkpoint(cp);
+        }
+
+        bool access(const AddrVec& addr_vec, const bool move_to_LRU = false) {
 
             int ind = (calc_entries_offset(addr_vec)/num_copy_rows);
             int& cur_access = cur_accesses[ind];
             cur_access++;
 
+            // restoring a row before its eviction is no reference to it
+            if(!move_to_LRU)
+                policy->on_access(ind, addr_vec[int(T::Level::Row)]);
+
             if(cur_access == hit_count_half_life) {
                 cur_access = 0;
 
                 // traverse all corresponding entries and halve their hit counts
-                auto& cur_lru_list = lru_lists[ind];
-
-                for(auto it = cur_lru_list.begin(); it != cur_lru_list.end(); it++) {
-                    (*it)->hit_count >>= 1;
-                } 
+                int offset = ind*num_copy_rows;
+                for(uint i = 0; i < num_copy_rows; i++) {
+                    if(tags[offset + i] != NO_TAG)
+                        entries[offset + i].hit_count >>= 1;
+                }
             }
 
             if(is_hit(addr_vec)) {
@@ -176,47 +180,38 @@ namespace ramulator {
                 if(cur_entry->hit_count < MAX_HIT_COUNT)
                     cur_entry->hit_count++;
 
-                auto& cur_lru_list = lru_lists[ind];
-                auto& cur_pointer_map = pointer_maps[ind];
-
-                cur_lru_list.erase(cur_pointer_map[cur_entry]);
-                if(!move_to_LRU) {
-                    cur_lru_list.push_front(cur_entry);
-                    cur_pointer_map[cur_entry] = cur_lru_list.begin();
-                } else {
-                    cur_lru_list.push_back(cur_entry);
-                    cur_pointer_map[cur_entry] = prev(cur_lru_list.end());
-                }
+                policy->on_hit(ind, cur_entry - entries - ind*num_copy_rows, move_to_LRU);
 
                 return true;
             }
             else {
                 assert(!move_to_LRU && "Error: Move to LRU should not be set on a miss!");
-                // do not insert to lru_list on miss
+                // do not insert to the replacement policy on miss
                 // insert only when add_entry() is called
-                
-                // decrease the hit counter of the LRU entry
-                //CROWEntry* LRU_entry = get_LRU_entry(addr_vec);
-                //if(LRU_entry->hit_count > 0)
-                //    LRU_entry->hit_count--;
             }
 
             return false;
 
         }
 
-        void make_LRU(const vector<int>& addr_vec, CROWEntry* crow_entry) {
+        // Makes crow_entry the one add_entry() evicts next in its set
+        void make_victim(const AddrVec& addr_vec, CROWEntry* crow_entry) {
             int ind = (calc_entries_offset(addr_vec)/num_copy_rows);
-            auto& cur_lru_list = lru_lists[ind];
-            auto& cur_pointer_map = pointer_maps[ind];
 
-            cur_lru_list.erase(cur_pointer_map[crow_entry]);
-            cur_lru_list.push_back(crow_entry);
-            cur_pointer_map[crow_entry] = prev(cur_lru_list.end());
+            policy->make_victim(ind, crow_entry - entries - ind*num_copy_rows);
+        }
+
+        // The set (subarray, or group of subarrays) the row of addr_vec maps to
+        int get_set_index(const AddrVec& addr_vec) {
+            return calc_entries_offset(addr_vec)/num_copy_rows;
         }
 
-        // this function does not update the LRU state
-		bool is_hit(const vector<int>& addr_vec) {
+        int get_num_sets() const {
+            return num_entries/num_copy_rows;
+        }
+
+        // this function does not update the replacement state
+		bool is_hit(const AddrVec& addr_vec) {
             if(get_hit_entry(addr_vec) != nullptr){
                 if(num_weak_rows == num_copy_rows)
                     assert(false && "WARNING: We should not get hit when all copy rows are allocated for weak rows.");
@@ -226,18 +221,20 @@ namespace ramulator {
             return false;
         }
 
-		CROWEntry* add_entry(const vector<int>& addr_vec, const bool FR) {
-            int lru_ind = calc_entries_offset(addr_vec)/num_copy_rows;
-            auto& cur_lru_list = lru_lists[lru_ind];
-            auto& cur_pointer_map = pointer_maps[lru_ind];
+		CROWEntry* add_entry(const AddrVec& addr_vec, const bool FR) {
+            int ind = calc_entries_offset(addr_vec)/num_copy_rows;
             CROWEntry* cur_entry = nullptr;
 
+            policy->on_access(ind, addr_vec[int(T::Level::Row)]);
+
         	int freeLoc = free_loc(addr_vec);
             if (freeLoc == -1) {
-		        cur_entry = get_LRU_entry(addr_vec);
+		        cur_entry = get_victim(ind, 0);
                                 
                 assert(!cur_entry->FR && "The discarded entry should not require full restoration!");
 
+                policy->on_evict(ind, cur_entry - entries - ind*num_copy_rows, *cur_entry);
+
                 if(cur_entry->total_hits == 0){
                     crow_evict_with_zero_hits++;
                     crow_evict_with_5_or_less_hits++;
@@ -261,15 +258,9 @@ namespace ramulator {
                 cur_entry->FR = FR;
                 cur_entry->hit_count = 0;
                 cur_entry->total_hits = 0;
+                update_tag(cur_entry);
 
                 update_next_copy_row_id(addr_vec);
-                
-                // remove the LRU entry from the list
-                assert(cur_lru_list.size() <= num_copy_rows);
-
-                                
-                cur_lru_list.pop_back();
-                cur_pointer_map.erase(cur_entry);
             } 
             else {
         		cur_entry = get_entry(addr_vec, uint(freeLoc));
@@ -278,45 +269,59 @@ namespace ramulator {
                 cur_entry->FR = FR;
                 cur_entry->hit_count = 0;
                 cur_entry->total_hits = 0;
-                
-                // As there is a free location, cur_lru_list should not be
-                // full
-                assert(cur_lru_list.size() < num_copy_rows && 
-                        "There is a free copy row, the LRU table should not be full!"); 
+                update_tag(cur_entry);
             }
 
-            float r = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-
-            if(r >= to_mru_frac){
-                cur_lru_list.push_back(cur_entry);
-                cur_pointer_map[cur_entry] = prev(cur_lru_list.end());
-            } else {
-                cur_lru_list.push_front(cur_entry);
-                cur_pointer_map[cur_entry] = cur_lru_list.begin();
-            }
+            policy->on_insert(ind, cur_entry - entries - ind*num_copy_rows, defer_insertion);
 
             return cur_entry;
         }
 
-        CROWEntry* get_entry(const vector<int>& addr_vec, const uint copy_row_id) {
+        // Lets the replacement policy draw the random number add_entry()
+        // skipped while defer_insertion was set
+        void finish_add_entry() {
+            policy->finish_insert();
+        }
+
+        CROWEntry* get_entry(const AddrVec& addr_vec, const uint copy_row_id) {
             int offset = calc_entries_offset(addr_vec);    
         	return &entries[offset + copy_row_id];
         }
 
-        CROWEntry* get_hit_entry(const vector<int>& addr_vec){
+        CROWEntry* get_hit_entry(const AddrVec& addr_vec){
             int offset = calc_entries_offset(addr_vec);
 
             int row_addr = addr_vec[int(T::Level::Row)];
-	        for (uint i = 0; i < num_copy_rows; i++) {
-            	if (entries[offset + i].row_addr == row_addr && 
-	        			entries[offset + i].valid && !entries[offset + i].is_to_remap_weak_row)
+            const int* set_tags = tags + offset;
+            uint i = 0;
+
+#ifdef __AVX2__
+            __m256i key8 = _mm256_set1_epi32(row_addr);
+            for (; i + 8 <= num_copy_rows; i += 8) {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(set_tags + i));
+                int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key8)));
+                if (mask)
+                    return &entries[offset + i + __builtin_ctz(mask)];
+            }
+#endif
+#ifdef __SSE2__
+            __m128i key4 = _mm_set1_epi32(row_addr);
+            for (; i + 4 <= num_copy_rows; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(set_tags + i));
+                int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key4)));
+                if (mask)
+                    return &entries[offset + i + __builtin_ctz(mask)];
+            }
+#endif
+	        for (; i < num_copy_rows; i++) {
+            	if (set_tags[i] == row_addr)
                 	return &entries[offset + i];
             }
 
             return nullptr;
         }
 
-		bool set_FR(const vector<int>& addr_vec, const bool FR) {
+		bool set_FR(const AddrVec& addr_vec, const bool FR) {
         	CROWEntry* cur_entry = get_hit_entry(addr_vec);
         
         	if(cur_entry == nullptr){
@@ -329,58 +334,62 @@ namespace ramulator {
         	return true;
         }
 
-        CROWEntry* get_LRU_entry(const vector<int>& addr_vec, int crow_evict_threshold = 0){
-            int lru_ind = calc_entries_offset(addr_vec)/num_copy_rows;
-            auto& cur_lru_list = lru_lists[lru_ind];
-
-            if(crow_evict_threshold == 0)
-                return cur_lru_list.back();
-
-            auto it = cur_lru_list.end();
-            do {
-                it--;
-                if((*it)->hit_count <= crow_evict_threshold)
-                    return *it;
-            } while(it != cur_lru_list.begin());
-
-            return nullptr;
+        // The entry the replacement policy would evict for the (missing)
+        // row of addr_vec, among those with at most crow_evict_threshold hits
+        // (any if 0). Returns nullptr if there is none, or if the policy
+        // does not admit the row into the table (then sets *rejected), in
+        // which case the caller must not copy it. The policy only counts an
+        // admission or ages the set once the victim is made the next one to
+        // evict (make_victim(), or access() to fully restore it) and evicted
+        // by add_entry().
+        CROWEntry* get_victim_entry(const AddrVec& addr_vec, int crow_evict_threshold = 0,
+                bool* rejected = nullptr){
+            int ind = calc_entries_offset(addr_vec)/num_copy_rows;
+
+            CROWEntry* victim = get_victim(ind, crow_evict_threshold);
+            bool admitted = victim == nullptr ||
+                    policy->admit(ind, addr_vec[int(T::Level::Row)], victim->row_addr);
+            if(rejected != nullptr)
+                *rejected = !admitted;
+            if(!admitted)
+                return nullptr;
+
+            return victim;
         }
 
-        CROWEntry* get_discarding_entry(const vector<int>& addr_vec){
+        CROWEntry* get_discarding_entry(const AddrVec& addr_vec){
             return get_entry(addr_vec, get_next_copy_row_id(addr_vec));
         }
 
-		bool get_discarding_FR(const vector<int>& addr_vec) {
+		bool get_discarding_FR(const AddrVec& addr_vec) {
             return get_entry(addr_vec, get_next_copy_row_id(addr_vec))->FR;
         }
 
-		ulong get_discarding_row_addr(const vector<int>& addr_vec) {
+		ulong get_discarding_row_addr(const AddrVec& addr_vec) {
             return get_entry(addr_vec, get_next_copy_row_id(addr_vec))->row_addr;
         }
 
-        int get_discarding_copy_row_id(const vector<int>& addr_vec) {
+        int get_discarding_copy_row_id(const AddrVec& addr_vec) {
             return get_next_copy_row_id(addr_vec);
         }
 
-		bool is_full(const vector<int>& addr_vec) {
+		bool is_full(const AddrVec& addr_vec) {
            return (free_loc(addr_vec) == -1); 
         }
 
-		void invalidate(const vector<int>& addr_vec) {
+		void invalidate(const AddrVec& addr_vec) {
             CROWEntry* entry = get_hit_entry(addr_vec);
             assert(!entry->is_to_remap_weak_row && "A remapped weak row should not be invalidated!");
-            int lru_ind = calc_entries_offset(addr_vec)/num_copy_rows;
-            auto& cur_lru_list = lru_lists[lru_ind];
-            auto& cur_pointer_map = pointer_maps[lru_ind];
+            int ind = calc_entries_offset(addr_vec)/num_copy_rows;
 
-            cur_lru_list.erase(cur_pointer_map[entry]);
-            cur_pointer_map.erase(entry);
+            policy->on_remove(ind, entry - entries - ind*num_copy_rows);
 
             entry->valid = false;
+            update_tag(entry);
 
         }
         
-        int find_not_FR(const vector<int>& addr_vec) {
+        int find_not_FR(const AddrVec& addr_vec) {
             int offset = calc_entries_offset(addr_vec);
 
             for(int i = 0; i < num_copy_rows; i++) {
@@ -404,6 +413,18 @@ namespace ramulator {
         int crow_id;
         CROWEntry* entries;
         int num_entries = 0;
+
+        // The row each entry can be hit for, or NO_TAG if it is invalid or
+        // holds a remapped weak row. Packed apart from the entries, so that
+        // get_hit_entry() compares a set's tags 4 (SSE2) or 8 (AVX2) at a
+        // time. Kept in sync by update_tag() whenever an entry changes.
+        static const int NO_TAG = -1;
+        int* tags;
+
+        void update_tag(CROWEntry* entry) {
+            bool hittable = entry->valid && !entry->is_to_remap_weak_row;
+            tags[entry - entries] = hittable ? int(entry->row_addr) : NO_TAG;
+        }
         int* sizes;
         uint* next_copy_row_id;
         uint num_SAs = 1;
@@ -418,24 +439,30 @@ namespace ramulator {
         const int MAX_HIT_COUNT = 32;
         int* cur_accesses = nullptr;
 
-        // LRU replacement policy
-        list<CROWEntry*>* lru_lists; //one for each subarray
-        unordered_map<CROWEntry*, list<CROWEntry*>::iterator>* pointer_maps;
+        // Selected with crow_replacement; works on the sets (subarrays) the
+        // entries are grouped into, i.e., entry i is way i%num_copy_rows of
+        // set i/num_copy_rows
+        CROWReplacement* policy;
+
+        CROWEntry* get_victim(int ind, int hit_threshold) {
+            int way = policy->get_victim(ind, entries + ind*num_copy_rows, hit_threshold);
+            return (way == -1) ? nullptr : &entries[ind*num_copy_rows + way];
+        }
 
 
-		void update_next_copy_row_id(const vector<int>& addr_vec) {
+		void update_next_copy_row_id(const AddrVec& addr_vec) {
             uint cur = get_next_copy_row_id(addr_vec);
 
             int offset = calc_next_copy_row_id_offset(addr_vec);
         	next_copy_row_id[offset] = (cur + 1) % num_copy_rows;
         }
 
-		uint get_next_copy_row_id(const vector<int>& addr_vec) {
+		uint get_next_copy_row_id(const AddrVec& addr_vec) {
             int offset = calc_next_copy_row_id_offset(addr_vec);
             return next_copy_row_id[offset]; 
         }
 
-		int free_loc(const vector<int>& addr_vec) {
+		int free_loc(const AddrVec& addr_vec) {
             for(uint i = 0; i < num_copy_rows; i++) {
         		if(!(get_entry(addr_vec, i)->valid))
 	        		return i;
@@ -444,7 +471,7 @@ namespace ramulator {
         	return -1;
         }
 
-        int calc_entries_offset(const vector<int>& addr_vec) {
+        int calc_entries_offset(const AddrVec& addr_vec) {
             int offset = 0;
 
             // skipping channel
@@ -463,7 +490,7 @@ namespace ramulator {
         }
 
 
-        int calc_next_copy_row_id_offset(const vector<int>& addr_vec) {
+        int calc_next_copy_row_id_offset(const AddrVec& addr_vec) {
            int offset = 0;
            // skipping channel
            for(int l = 1; l <= int(T::Level::Bank); l++) {
@@ -487,7 +514,7 @@ namespace ramulator {
             if(num_grouped_SAs > 1)
                 assert(num_weak_rows == 0 && "Error: Weak row remapping is not yet implemented to work with SA grouping");
 
-            vector<int> addr_vec(int(T::Level::MAX), 0);
+            AddrVec addr_vec(int(T::Level::MAX), 0);
 
 
             for(int r = 0; r < spec->org_entry.count[int(T::Level::Rank)]; r++){
@@ -503,6 +530,7 @@ namespace ramulator {
                             CROWEntry* entry = entries + offset + j;
                             entry->is_to_remap_weak_row = true;
                             entry->valid = true;
+                            update_tag(entry);
                         }
                     }
                 }
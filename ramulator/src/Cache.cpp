@@ -13,9 +13,12 @@
 namespace ramulator
 {
 
+const long Cache::NO_TAG;
+const long Cache::NO_MSHR;
+
 Cache::Cache(int size, int assoc, int block_size,
     int mshr_entry_num, Level level,
-    std::shared_ptr<CacheSystem> cachesys):
+    std::shared_ptr<CacheSystem> cachesys, int core_id):
     level(level), cachesys(cachesys), higher_cache(0),
     lower_cache(nullptr), size(size), assoc(assoc),
     block_size(block_size), mshr_entry_num(mshr_entry_num) {
@@ -30,6 +33,8 @@ Cache::Cache(int size, int assoc, int block_size,
   } else if (level == Level::L3) {
     level_string = "L3";
   }
+  // the private caches of the cores would otherwise share their stat names
+  string core_suffix = (core_id < 0) ? "" : "_core_" + to_string(core_id);
 
   is_first_level = (level == cachesys->first_level);
   is_last_level = (level == cachesys->last_level);
@@ -46,6 +51,15 @@ Cache::Cache(int size, int assoc, int block_size,
   index_offset = calc_log2(block_size);
   tag_offset = calc_log2(block_num) + index_offset;
 
+  tags.assign(block_num * assoc, NO_TAG);
+  lines.resize(block_num * assoc);
+  lru.assign(block_num * assoc, 0);
+  set_sizes.assign(block_num, 0);
+
+  mshr_bits = calc_log2(max(mshr_entry_num, 1) * 2 - 1) + 1;
+  mshr_addrs.assign(1 << mshr_bits, NO_MSHR);
+  mshr_lines.assign(1 << mshr_bits, nullptr);
+
   prefetcher = nullptr;
 
   debug("index_offset %d", index_offset);
@@ -53,67 +67,71 @@ Cache::Cache(int size, int assoc, int block_size,
   debug("tag_offset %d", tag_offset);
 
   // regStats
-  cache_read_miss.name(level_string + string("_cache_read_miss"))
+  cache_read_miss.name(level_string + string("_cache_read_miss") + core_suffix)
                  .desc("cache read miss count")
                  .precision(0)
                  ;
 
-  cache_write_miss.name(level_string + string("_cache_write_miss"))
+  cache_write_miss.name(level_string + string("_cache_write_miss") + core_suffix)
                   .desc("cache write miss count")
                   .precision(0)
                   ;
-  cache_prefetch_miss.name(level_string + string("_cache_prefetch_miss"))
+  cache_prefetch_miss.name(level_string + string("_cache_prefetch_miss") + core_suffix)
                   .desc("cache prefetch miss count")
                   .precision(0)
                   ;
 
-  cache_prefetch_hit.name(level_string + string("_cache_prefetch_hit"))
+  cache_prefetch_hit.name(level_string + string("_cache_prefetch_hit") + core_suffix)
                     .desc("prefetch requests that were already in the cache")
                     .precision(0)
                     ;
 
-  cache_total_miss.name(level_string + string("_cache_total_miss"))
+  cache_total_miss.name(level_string + string("_cache_total_miss") + core_suffix)
                   .desc("cache total miss count")
                   .precision(0)
                   ;
 
-  cache_eviction.name(level_string + string("_cache_eviction"))
+  cache_eviction.name(level_string + string("_cache_eviction") + core_suffix)
                 .desc("number of evict from this level to lower level")
                 .precision(0)
                 ;
 
-  cache_read_access.name(level_string + string("_cache_read_access"))
+  cache_read_access.name(level_string + string("_cache_read_access") + core_suffix)
                   .desc("cache read access count")
                   .precision(0)
                   ;
 
-  cache_write_access.name(level_string + string("_cache_write_access"))
+  cache_write_access.name(level_string + string("_cache_write_access") + core_suffix)
                     .desc("cache write access count")
                     .precision(0)
                     ;
 
-  cache_prefetch_access.name(level_string + string("_cache_prefetch_access"))
+  cache_prefetch_access.name(level_string + string("_cache_prefetch_access") + core_suffix)
                        .desc("cache prefetch access count")
                        .precision(0)
                        ;
 
-  cache_total_access.name(level_string + string("_cache_total_access"))
+  cache_total_access.name(level_string + string("_cache_total_access") + core_suffix)
                     .desc("cache total access count")
                     .precision(0)
                     ;
 
-  cache_mshr_hit.name(level_string + string("_cache_mshr_hit"))
+  cache_mshr_hit.name(level_string + string("_cache_mshr_hit") + core_suffix)
                 .desc("cache mshr hit count")
                 .precision(0)
                 ;
-  cache_mshr_unavailable.name(level_string + string("_cache_mshr_unavailable"))
+  cache_mshr_unavailable.name(level_string + string("_cache_mshr_unavailable") + core_suffix)
                          .desc("cache mshr not available count")
                          .precision(0)
                          ;
-  cache_set_unavailable.name(level_string + string("_cache_set_unavailable"))
+  cache_set_unavailable.name(level_string + string("_cache_set_unavailable") + core_suffix)
                          .desc("cache set not available")
                          .precision(0)
                          ;
+  cache_mshr_occupancy.name(level_string + string("_cache_mshr_occupancy") + core_suffix)
+                      .desc("average number of mshr entries in use per cycle")
+                      .precision(6)
+                      ;
 }
 
 bool Cache::send(Request req) {
@@ -131,21 +149,20 @@ bool Cache::send(Request req) {
     cache_prefetch_access++;
   }
 
-  // If there isn't a set, create it.
-  auto& lines = get_lines(req.addr);
-  std::list<Line>::iterator line;
+  int set = get_index(req.addr);
+  int way;
 
-  if (is_hit(lines, req.addr, &line)) {
+  if (is_hit(set, req.addr, &way)) {
       if(req.type == Request::Type::PREFETCH) {
           cache_prefetch_hit++;
           return true;;
       }
 
-    lines.push_back(Line(req.addr, get_tag(req.addr), false,
-        line->dirty || (req.type == Request::Type::WRITE)));
-    lines.erase(line);
-    cachesys->hit_list.push_back(
-        make_pair(cachesys->clk + latency[int(level)], req));
+    Line& line = get_line(set, way);
+    line = Line(req.addr, get_tag(req.addr), false,
+        line.dirty || (req.type == Request::Type::WRITE));
+    touch(set, way);
+    push_hit(cachesys->clk + latency[int(level)], req);
 
     debug("hit, update timestamp %ld", cachesys->clk);
     debug("hit finish time %ld",
@@ -178,23 +195,24 @@ bool Cache::send(Request req) {
 
     // Look it up in MSHR entries
     assert((req.type == Request::Type::READ) || (req.type == Request::Type::PREFETCH));
-    auto mshr = hit_mshr(req.addr);
-    if (mshr != mshr_entries.end()) {
+    int mshr = hit_mshr(req.addr);
+    if (mshr != -1) {
       debug("hit mshr");
       cache_mshr_hit++;
-      mshr->second->dirty = dirty || mshr->second->dirty;
+      Line* mshr_line = mshr_lines[mshr];
+      mshr_line->dirty = dirty || mshr_line->dirty;
       // FIXME: Shall we train the prefetcher on MSHR hit???
       // if(prefetcher)
       //    prefetcher->miss(req.addr, cachesys->clk);
       
       // upgrade the previous prefetch request to demand request so the
       // processor will be informed on completion of the request
-      if (prefetcher && (req.type == Request::Type::READ) && mshr->second->is_prefetch){
+      if (prefetcher && (req.type == Request::Type::READ) && mshr_line->is_prefetch){
         bool is_upgraded = cachesys->upgrade_prefetch_req(align(req.addr));
         if(!is_upgraded)
             printf("Address of the request failed to upgrade: %ld\n", align(req.addr));
         assert(is_upgraded && "ERROR: Failed to upgrade a PREFETCH request to READ!");
-        mshr->second->is_prefetch = false;
+        mshr_line->is_prefetch = false;
       }
 
       return true;
@@ -202,7 +220,7 @@ bool Cache::send(Request req) {
 
     // All requests come to this stage will be READ, so they
     // should be recorded in MSHR entries.
-    if (mshr_entries.size() == mshr_entry_num) {
+    if (mshr_num == mshr_entry_num) {
       // When no MSHR entries available, the miss request
       // is stalling.
       cache_mshr_unavailable++;
@@ -211,27 +229,26 @@ bool Cache::send(Request req) {
     }
 
     // Check whether there is a line available
-    if (all_sets_locked(lines)) {
+    if (all_sets_locked(set)) {
       cache_set_unavailable++;
       return false;
     }
 
-    auto newline = allocate_line(lines, req.addr);
-    if (newline == lines.end()) {
+    auto newline = allocate_line(set, req.addr);
+    if (newline == nullptr) {
       return false;
     }
 
     newline->dirty = dirty;
 
     // Add to MSHR entries
-    mshr_entries.push_back(make_pair(req.addr, newline));
+    add_mshr(req.addr, newline);
 
     // Send the request to next level;
     if (!is_last_level) {
-      lower_cache->send(req);
+      send_lower(req);
     } else {
-      cachesys->wait_list.push_back(
-          make_pair(cachesys->clk + latency[int(level)], req));
+      push_wait(cachesys->clk + latency[int(level)], req);
     }
 
     if (prefetcher) {
@@ -247,40 +264,90 @@ bool Cache::send(Request req) {
   }
 }
 
+void Cache::warm(Request req) {
+  int set = get_index(req.addr);
+  int way = find_way(set, get_tag(req.addr));
+  bool dirty = (req.type == Request::Type::WRITE);
+
+  if (way != -1) {
+    Line& line = get_line(set, way);
+    if (line.lock) {
+      // still being filled for the detailed simulation
+      line.dirty = line.dirty || dirty;
+    } else {
+      line = Line(req.addr, get_tag(req.addr), false, line.dirty || dirty);
+      touch(set, way);
+    }
+    return;
+  }
+
+  // Fill from the lower level first, as its eviction may invalidate lines
+  // of this level
+  req.type = Request::Type::READ;
+  if (!is_last_level) {
+    lower_cache->warm(req);
+  } else {
+    cachesys->warm_memory(req);
+  }
+
+  if (set_sizes[set] >= assoc) {
+    int victim = find_victim(set);
+    if (victim == -1) {
+      return;
+    }
+    evict(set, victim, true);
+  }
+  insert_line(set, Line(req.addr, get_tag(req.addr), false, dirty));
+}
+
+void Cache::checkpoint(Checkpoint& cp) {
+  assert(mshr_num == 0 &&
+      "Error: cannot checkpoint a cache with outstanding misses.");
+  cp.check(tags.size(), "cache size");
+  cp.io(tags);
+  cp.io(lines);
+  cp.io(lru);
+  cp.io(set_sizes);
+  cp.io(lru_clk);
+  cp.check(prefetcher != nullptr, "prefetcher");
+  if (prefetcher != nullptr) {
+    prefetcher->checkpoint(cp);
+  }
+}
+
 void Cache::evictline(long addr, bool dirty) {
 
-  auto it = cache_lines.find(get_index(addr));
-  assert(it != cache_lines.end()); // check inclusive cache
-  auto& lines = it->second;
-  auto line = find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){return (l.tag == get_tag(addr));});
+  int set = get_index(addr);
+  int way = find_way(set, get_tag(addr));
 
-  assert(line != lines.end());
+  assert(way != -1); // check inclusive cache
   // Update LRU queue. The dirty bit will be set if the dirty
   // bit inherited from higher level(s) is set.
-  lines.push_back(Line(addr, get_tag(addr), false,
-      dirty || line->dirty));
-  lines.erase(line);
+  Line& line = get_line(set, way);
+  line = Line(addr, get_tag(addr), false, dirty || line.dirty);
+  touch(set, way);
 }
 
 std::pair<long, bool> Cache::invalidate(long addr) {
   long delay = latency_each[int(level)];
   bool dirty = false;
 
-  auto& lines = get_lines(addr);
-  if (lines.size() == 0) {
+  int set = get_index(addr);
+  if (set_sizes[set] == 0) {
     // The line of this address doesn't exist.
     return make_pair(0, false);
   }
-  auto line = find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){return (l.tag == get_tag(addr));});
+  int way = find_way(set, get_tag(addr));
+  bool line_dirty;
 
   // If the line is in this level cache, then erase it from
   // the buffer.
-  if (line != lines.end()) {
-    assert(!line->lock);
+  if (way != -1) {
+    Line& line = get_line(set, way);
+    assert(!line.lock);
     debug("invalidate %lx @ level %d", addr, int(level));
-    lines.erase(line);
+    line_dirty = line.dirty;
+    remove_line(set, way);
   } else {
     // If it's not in current level, then no need to go up.
     return make_pair(delay, false);
@@ -295,20 +362,22 @@ std::pair<long, bool> Cache::invalidate(long addr) {
       } else {
         max_delay = max(max_delay, delay + result.first);
       }
-      dirty = dirty || line->dirty || result.second;
+      dirty = dirty || line_dirty || result.second;
     }
     delay = max_delay;
   } else {
-    dirty = line->dirty;
+    dirty = line_dirty;
   }
   return make_pair(delay, dirty);
 }
 
 
-void Cache::evict(std::list<Line>* lines,
-    std::list<Line>::iterator victim) {
+void Cache::evict(int set, int victim_way, bool warm) {
+  Line* victim = &get_line(set, victim_way);
   debug("level %d miss evict victim %lx", int(level), victim->addr);
-  cache_eviction++;
+  if (!warm) {
+    cache_eviction++;
+  }
 
   long addr = victim->addr;
   long invalidate_time = 0;
@@ -330,14 +399,15 @@ void Cache::evict(std::list<Line>* lines,
   if (!is_last_level) {
     // not LLC eviction
     assert(lower_cache != nullptr);
-    lower_cache->evictline(addr, dirty);
+    evictline_lower(addr, dirty);
   } else {
     // LLC eviction
-    if (dirty) {
+    if (dirty && warm) {
+      cachesys->warm_memory(Request(addr, Request::Type::WRITE));
+    } else if (dirty) {
       Request write_req(addr, Request::Type::WRITE);
-      cachesys->wait_list.push_back(make_pair(
-          cachesys->clk + invalidate_time + latency[int(level)],
-          write_req));
+      push_wait(cachesys->clk + invalidate_time + latency[int(level)],
+          write_req);
 
       debug("inject one write request to memory system "
           "addr %lx, invalidate time %ld, issue time %ld",
@@ -346,51 +416,160 @@ void Cache::evict(std::list<Line>* lines,
     }
   }
 
-  lines->erase(victim);
+  remove_line(set, victim_way);
+}
+
+void Cache::push_hit(long ready, const Request& req) {
+  if (deferred != nullptr) {
+    deferred->push_hit(ready, req);
+  } else {
+    cachesys->push_hit(ready, req);
+  }
+}
+
+void Cache::push_wait(long ready, const Request& req) {
+  if (deferred != nullptr) {
+    deferred->push_wait(ready, req);
+  } else {
+    cachesys->push_wait(ready, req);
+  }
+}
+
+void Cache::send_lower(const Request& req) {
+  if (deferred != nullptr && lower_cache->deferred == nullptr) {
+    deferred->send(lower_cache, req);
+  } else {
+    lower_cache->send(req);
+  }
+}
+
+void Cache::evictline_lower(long addr, bool dirty) {
+  if (deferred != nullptr && lower_cache->deferred == nullptr) {
+    deferred->evictline(lower_cache, addr, dirty);
+  } else {
+    lower_cache->evictline(addr, dirty);
+  }
 }
 
-std::list<Cache::Line>::iterator Cache::allocate_line(
-    std::list<Line>& lines, long addr) {
+void DeferredOps::replay(CacheSystem& cachesys) {
+  for (auto& op : ops) {
+    switch (op.type) {
+      case Op::Type::Hit:
+        cachesys.push_hit(op.value, op.req);
+        break;
+      case Op::Type::Wait:
+        cachesys.push_wait(op.value, op.req);
+        break;
+      case Op::Type::Send:
+        op.cache->send(op.req);
+        break;
+      case Op::Type::EvictLine:
+        op.cache->evictline(op.value, op.dirty);
+        break;
+    }
+  }
+  ops.clear();
+}
+
+Cache::Line* Cache::allocate_line(int set, long addr) {
   // See if an eviction is needed
-  if (need_eviction(lines, addr)) {
+  if (need_eviction(set, addr)) {
     // Get victim.
     // The first one might still be locked due to reorder in MC
-    auto victim = find_if(lines.begin(), lines.end(),
-        [this](Line line) {
-          bool check = !line.lock;
-          if (!is_first_level) {
-            for (auto hc : higher_cache) {
-              if(!check) {
-                return check;
-              }
-              check = check && hc->check_unlock(line.addr);
-            }
-          }
-          return check;
-        });
-    if (victim == lines.end()) {
-      return victim;  // doesn't exist a line that's already unlocked in each level
+    int victim = find_victim(set);
+    if (victim == -1) {
+      return nullptr;  // doesn't exist a line that's already unlocked in each level
     }
-    assert(victim != lines.end());
-    evict(&lines, victim);
+    evict(set, victim);
   }
 
   // Allocate newline, with lock bit on and dirty bit off
-  lines.push_back(Line(addr, get_tag(addr)));
-  auto last_element = lines.end();
-  --last_element;
-  return last_element;
+  return insert_line(set, Line(addr, get_tag(addr)));
+}
+
+Cache::Line* Cache::insert_line(int set, const Line& line) {
+  int way = find_way(set, NO_TAG);
+  assert(way != -1);
+  tags[set * assoc + way] = line.tag;
+  get_line(set, way) = line;
+  touch(set, way);
+  set_sizes[set]++;
+  return &get_line(set, way);
 }
 
-bool Cache::is_hit(std::list<Line>& lines, long addr,
-    std::list<Line>::iterator* pos_ptr) {
-  auto pos = find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){return (l.tag == get_tag(addr));});
-  *pos_ptr = pos;
-  if (pos == lines.end()) {
+int Cache::find_victim(int set) {
+  // Try the lines from the least recently used one. The stamps of a set
+  // are distinct, so each pass takes the oldest line after the last one
+  // tried.
+  const long* set_tags = &tags[set * assoc];
+  const long* set_lru = &lru[set * assoc];
+  long tried = -1;
+  for (unsigned int i = 0; i < set_sizes[set]; i++) {
+    int way = -1;
+    for (unsigned int w = 0; w < assoc; w++) {
+      if (set_tags[w] != NO_TAG && set_lru[w] > tried &&
+          (way == -1 || set_lru[w] < set_lru[way])) {
+        way = w;
+      }
+    }
+    tried = set_lru[way];
+
+    Line& line = get_line(set, way);
+    bool check = !line.lock;
+    if (!is_first_level) {
+      for (auto hc : higher_cache) {
+        if (!check) {
+          break;
+        }
+        check = check && hc->check_unlock(line.addr);
+      }
+    }
+    if (check) {
+      return way;
+    }
+  }
+  return -1;
+}
+
+bool Cache::is_hit(int set, long addr, int* way_ptr) {
+  int way = find_way(set, get_tag(addr));
+  *way_ptr = way;
+  if (way == -1) {
     return false;
   }
-  return !pos->lock;
+  return !get_line(set, way).lock;
+}
+
+void Cache::add_mshr(long addr, Line* line) {
+  long line_addr = align(addr);
+  unsigned int mask = mshr_addrs.size() - 1;
+  unsigned int i = mshr_home(line_addr);
+  while (mshr_addrs[i] != NO_MSHR) {
+    i = (i + 1) & mask;
+  }
+  mshr_addrs[i] = line_addr;
+  mshr_lines[i] = line;
+  mshr_num++;
+  cache_mshr_occupancy = mshr_num;
+}
+
+void Cache::remove_mshr(unsigned int slot) {
+  // Shift the following entries of the probe sequence back into the
+  // hole, so that no lookup stops early at it
+  unsigned int mask = mshr_addrs.size() - 1;
+  unsigned int hole = slot;
+  for (unsigned int i = (slot + 1) & mask; mshr_addrs[i] != NO_MSHR;
+      i = (i + 1) & mask) {
+    unsigned int home = mshr_home(mshr_addrs[i]);
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      mshr_addrs[hole] = mshr_addrs[i];
+      mshr_lines[hole] = mshr_lines[i];
+      hole = i;
+    }
+  }
+  mshr_addrs[hole] = NO_MSHR;
+  mshr_num--;
+  cache_mshr_occupancy = mshr_num;
 }
 
 void Cache::concatlower(Cache* lower) {
@@ -399,15 +578,12 @@ void Cache::concatlower(Cache* lower) {
   lower->higher_cache.push_back(this);
 };
 
-bool Cache::need_eviction(const std::list<Line>& lines, long addr) {
-  if (find_if(lines.begin(), lines.end(),
-      [addr, this](Line l){
-        return (get_tag(addr) == l.tag);})
-      != lines.end()) {
+bool Cache::need_eviction(int set, long addr) {
+  if (find_way(set, get_tag(addr)) != -1) {
     // Due to MSHR, the program can't reach here. Just for checking
     assert(false);
   } else {
-    if (lines.size() < assoc) {
+    if (set_sizes[set] < assoc) {
       return false;
     } else {
       return true;
@@ -418,14 +594,10 @@ bool Cache::need_eviction(const std::list<Line>& lines, long addr) {
 void Cache::callback(Request& req) {
   debug("level %d", int(level));
 
-  auto it = find_if(mshr_entries.begin(), mshr_entries.end(),
-      [&req, this](std::pair<long, std::list<Line>::iterator> mshr_entry) {
-        return (align(mshr_entry.first) == align(req.addr));
-      });
-
-  if (it != mshr_entries.end()) {
-    it->second->lock = false;
-    mshr_entries.erase(it);
+  int mshr = hit_mshr(req.addr);
+  if (mshr != -1) {
+    mshr_lines[mshr]->lock = false;
+    remove_mshr(mshr);
   }
 
   if (req.type != Request::Type::PREFETCH) // to prefetch only to LLC
@@ -450,39 +622,52 @@ void CacheSystem::tick() {
 
       debug("complete req: addr %lx", (it->second).addr);
 
+      if (it->second.type == Request::Type::PREFETCH) {
+        wait_prefetches.erase(it->second.addr);
+      }
       it = wait_list.erase(it);
     }
   }
 
   // hit request callback
-  it = hit_list.begin();
-  while (it != hit_list.end()) {
-    if (clk >= it->first) {
-      it->second.callback(it->second);
+  while (!hit_list.empty() && clk >= hit_list.top().ready) {
+    Request req = hit_list.top().req;
+    hit_list.pop();
+    req.callback(req);
 
-      debug("finish hit: addr %lx", (it->second).addr);
-
-      it = hit_list.erase(it);
-    } else {
-      ++it;
-    }
+    debug("finish hit: addr %lx", req.addr);
   }
 }
 
-bool CacheSystem::upgrade_prefetch_req(long addr) {
+long CacheSystem::get_idle_cycles() {
+  // tick() stops at the first waiting request that is not due yet
+  long next = numeric_limits<long>::max();
+  if (wait_list.size()) {
+    next = wait_list.front().first;
+  }
+  if (hit_list.size()) {
+    next = min(next, hit_list.top().ready);
+  }
+  if (next == numeric_limits<long>::max()) {
+    return next;
+  }
+  return max(next - clk - 1, 0l);
+}
 
-    if(wait_list.size() != 0){
+void CacheSystem::skip(long cycles) {
+  clk += cycles;
+}
 
-        auto pref_req = find_if(wait_list.begin(), wait_list.end(), 
-                                                [addr](pair<long, Request>& preq) {
-                        return (addr == preq.second.addr) && preq.second.type == Request::Type::PREFETCH;});
+bool CacheSystem::upgrade_prefetch_req(long addr) {
 
-        if (pref_req != wait_list.end()) {
-            (pref_req->second).type = Request::Type::READ;
-            (pref_req->second).callback = (pref_req->second).proc_callback; // FIXME: proc_callback is an ugly workaround
-            return true;
-        }
-     }
+    auto pref = wait_prefetches.find(addr);
+    if (pref != wait_prefetches.end()) {
+        auto pref_req = pref->second;
+        (pref_req->second).type = Request::Type::READ;
+        (pref_req->second).callback = (pref_req->second).proc_callback; // FIXME: proc_callback is an ugly workaround
+        wait_prefetches.erase(pref);
+        return true;
+    }
 
     return upgrade_prefetch_req_in_mem(addr);
 }
@@ -1,6 +1,7 @@
 #ifndef __CACHE_H
 #define __CACHE_H
 
+#include "Checkpoint.h"
 #include "Config.h"
 #include "Request.h"
 #include "Statistics.h"
@@ -9,15 +10,48 @@
 #include <cstdio>
 #include <cassert>
 #include <functional>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
 #include <queue>
-#include <list>
+#include <unordered_map>
 
 namespace ramulator
 {
 class CacheSystem;
+class Cache;
+
+/* The operations of a core's private caches on the state that all cores
+ * share (the lists of the CacheSystem and the LLC), queued while the core
+ * advances in parallel with the others (see Cache::deferred). Replaying
+ * them in core order keeps the results independent of the threads. */
+class DeferredOps {
+public:
+  void push_hit(long ready, const Request& req) {
+    ops.push_back(Op{Op::Type::Hit, ready, req, nullptr, false});
+  }
+  void push_wait(long ready, const Request& req) {
+    ops.push_back(Op{Op::Type::Wait, ready, req, nullptr, false});
+  }
+  void send(Cache* cache, const Request& req) {
+    ops.push_back(Op{Op::Type::Send, 0, req, cache, false});
+  }
+  void evictline(Cache* cache, long addr, bool dirty) {
+    ops.push_back(Op{Op::Type::EvictLine, addr, Request(), cache, dirty});
+  }
+  void replay(CacheSystem& cachesys);
+
+private:
+  struct Op {
+    enum class Type {Hit, Wait, Send, EvictLine} type;
+    long value; // the ready cycle (Hit, Wait) or the address (EvictLine)
+    Request req;
+    Cache* cache;
+    bool dirty;
+  };
+  std::vector<Op> ops;
+};
 
 class Cache {
 protected:
@@ -34,6 +68,7 @@ protected:
   ScalarStat cache_mshr_hit;
   ScalarStat cache_mshr_unavailable;
   ScalarStat cache_set_unavailable;
+  AverageStat cache_mshr_occupancy;
 public:
   enum class Level {
     L1,
@@ -53,10 +88,12 @@ public:
         addr(addr), tag(tag), lock(true), dirty(false), is_prefetch(false) {}
     Line(long addr, long tag, bool lock, bool dirty):
         addr(addr), tag(tag), lock(lock), dirty(dirty), is_prefetch(false) {}
+    Line() : Line(0, 0) {}
   };
 
+  // core_id is that of the core owning a private cache, -1 for a shared one
   Cache(int size, int assoc, int block_size, int mshr_entry_num,
-      Level level, std::shared_ptr<CacheSystem> cachesys);
+      Level level, std::shared_ptr<CacheSystem> cachesys, int core_id = -1);
 
   // L1, L2, L3 accumulated latencies
   int latency[int(Level::MAX)] = {4, 4 + 12, 4 + 12 + 31};
@@ -69,13 +106,30 @@ public:
 
   StridePrefetcher* prefetcher; 
 
+  // Set on the private caches of a core while it sends a request in
+  // parallel with the other cores: what send() would do to the CacheSystem
+  // or to a lower cache without deferred (the LLC) is queued in it instead
+  DeferredOps* deferred = nullptr;
+
   bool send(Request req);
 
+  // Functional counterpart of send() for the fast-forwarded parts of a
+  // sampled simulation: updates the lines (LRU order, dirty bits,
+  // evictions) as if the access completed at once, without statistics,
+  // MSHRs or latencies. Misses and dirty LLC evictions are passed on to
+  // the lower level, or to CacheSystem::warm_memory.
+  void warm(Request req);
+
   void concatlower(Cache* lower);
 
   void callback(Request& req);
 
+  // Save or load the lines (and the prefetcher's tables). No miss may be
+  // outstanding.
+  void checkpoint(Checkpoint& cp);
+
 protected:
+  friend class DeferredOps;
 
   bool is_first_level;
   bool is_last_level;
@@ -87,9 +141,26 @@ protected:
   unsigned int index_offset;
   unsigned int tag_offset;
   unsigned int mshr_entry_num;
-  std::vector<std::pair<long, std::list<Line>::iterator>> mshr_entries;
 
-  std::map<int, std::list<Line> > cache_lines;
+  // The MSHRs, an open-addressing hash table with linear probing on the
+  // aligned line address. It has a power of two slots, at least twice
+  // mshr_entry_num, so that the probe sequences stay short.
+  static const long NO_MSHR = -1;
+  std::vector<long> mshr_addrs; // NO_MSHR for a free slot
+  std::vector<Line*> mshr_lines;
+  unsigned int mshr_bits;
+  unsigned int mshr_num = 0; // MSHRs in use
+
+  // The lines are preallocated, way w of set i at i * assoc + w. A way
+  // holds a line iff its tag is not NO_TAG; the tags are also kept apart
+  // from the lines so that a lookup scans a contiguous array. The lines of
+  // a set are ordered from least to most recently used by their lru stamps.
+  static const long NO_TAG = -1;
+  std::vector<long> tags;
+  std::vector<Line> lines;
+  std::vector<long> lru;
+  std::vector<unsigned int> set_sizes; // number of lines in each set
+  long lru_clk = 0;
 
   int calc_log2(int val) {
       int n = 0;
@@ -111,6 +182,36 @@ protected:
     return (addr & ~(block_size-1l));
   }
 
+  Line& get_line(int set, int way) {
+    return lines[set * assoc + way];
+  }
+
+  // The way of the set that holds the tag, or -1. A tag is in a set at
+  // most once, so the scan does not stop early, which lets the compiler
+  // vectorize it.
+  int find_way(int set, long tag) {
+    const long* set_tags = &tags[set * assoc];
+    int way = -1;
+    for (unsigned int w = 0; w < assoc; w++) {
+      way = (set_tags[w] == tag) ? int(w) : way;
+    }
+    return way;
+  }
+
+  // Make the line in the way the most recently used one of its set
+  void touch(int set, int way) {
+    lru[set * assoc + way] = ++lru_clk;
+  }
+
+  // Put the line into a free way of the set, as the most recently used
+  // line, and return it
+  Line* insert_line(int set, const Line& line);
+
+  void remove_line(int set, int way) {
+    tags[set * assoc + way] = NO_TAG;
+    set_sizes[set]--;
+  }
+
   // Evict the cache line from higher level to this level.
   // Pass the dirty bit and update LRU queue.
   void evictline(long addr, bool dirty);
@@ -121,33 +222,35 @@ protected:
   // in higher level and this level.
   std::pair<long, bool> invalidate(long addr);
 
-  // Evict the victim from current set of lines.
+  // Evict the victim from the set.
   // First do invalidation, then call evictline(L1 or L2) or send
-  // a write request to memory(L3) when dirty bit is on.
-  void evict(std::list<Line>* lines,
-      std::list<Line>::iterator victim);
+  // a write request to memory(L3) when dirty bit is on. With warm,
+  // the write request is warmed instead (see warm()).
+  void evict(int set, int victim, bool warm = false);
+
+  // The way of the least recently used line of the set that is unlocked
+  // in this level and all higher levels, or -1
+  int find_victim(int set);
 
   // First test whether need eviction, if so, do eviction by
   // calling evict function. Then allocate a new line and return
-  // the iterator points to it.
-  std::list<Line>::iterator allocate_line(
-      std::list<Line>& lines, long addr);
+  // a pointer to it, or nullptr if no line could be evicted.
+  Line* allocate_line(int set, long addr);
 
   // Check whether the set to hold addr has space or eviction is
   // needed.
-  bool need_eviction(const std::list<Line>& lines, long addr);
+  bool need_eviction(int set, long addr);
 
-  // Check whether this addr is hit and fill in the pos_ptr with
-  // the iterator to the hit line or lines.end()
-  bool is_hit(std::list<Line>& lines, long addr,
-              std::list<Line>::iterator* pos_ptr);
+  // Check whether this addr is hit and fill in the way_ptr with
+  // the way of the line or -1
+  bool is_hit(int set, long addr, int* way_ptr);
 
-  bool all_sets_locked(const std::list<Line>& lines) {
-    if (lines.size() < assoc) {
+  bool all_sets_locked(int set) {
+    if (set_sizes[set] < assoc) {
       return false;
     }
-    for (const auto& line : lines) {
-      if (!line.lock) {
+    for (unsigned int w = 0; w < assoc; w++) {
+      if (!get_line(set, w).lock) {
         return false;
       }
     }
@@ -155,51 +258,54 @@ protected:
   }
 
   bool check_unlock(long addr) {
-    auto it = cache_lines.find(get_index(addr));
-    if (it == cache_lines.end()) {
+    int set = get_index(addr);
+    int way = find_way(set, get_tag(addr));
+    if (way == -1) {
       return true;
     } else {
-      auto& lines = it->second;
-      auto line = find_if(lines.begin(), lines.end(),
-          [addr, this](Line l){return (l.tag == get_tag(addr));});
-      if (line == lines.end()) {
-        return true;
-      } else {
-        bool check = !line->lock;
-        if (!is_first_level) {
-          for (auto hc : higher_cache) {
-            if (!check) {
-              return check;
-            }
-            check = check && hc->check_unlock(line->addr);
+      Line& line = get_line(set, way);
+      bool check = !line.lock;
+      if (!is_first_level) {
+        for (auto hc : higher_cache) {
+          if (!check) {
+            return check;
           }
+          check = check && hc->check_unlock(line.addr);
         }
-        return check;
       }
+      return check;
     }
   }
 
-  std::vector<std::pair<long, std::list<Line>::iterator>>::iterator
-  hit_mshr(long addr) {
-    auto mshr_it =
-        find_if(mshr_entries.begin(), mshr_entries.end(),
-            [addr, this](std::pair<long, std::list<Line>::iterator>
-                   mshr_entry) {
-              return (align(mshr_entry.first) == align(addr));
-            });
-
-    return mshr_it;
+  // The slot a line address is probed from (Fibonacci hashing of the
+  // line number)
+  unsigned int mshr_home(long line_addr) {
+    return ((unsigned long)(line_addr >> index_offset) *
+        0x9e3779b97f4a7c15ul) >> (64 - mshr_bits);
   }
 
-  std::list<Line>& get_lines(long addr) {
-    if (cache_lines.find(get_index(addr))
-        == cache_lines.end()) {
-      cache_lines.insert(make_pair(get_index(addr),
-          std::list<Line>()));
+  // The slot of the MSHR of the line holding addr, or -1
+  int hit_mshr(long addr) {
+    long line_addr = align(addr);
+    unsigned int mask = mshr_addrs.size() - 1;
+    for (unsigned int i = mshr_home(line_addr); mshr_addrs[i] != NO_MSHR;
+        i = (i + 1) & mask) {
+      if (mshr_addrs[i] == line_addr) {
+        return i;
+      }
     }
-    return cache_lines[get_index(addr)];
+    return -1;
   }
 
+  void add_mshr(long addr, Line* line);
+  void remove_mshr(unsigned int slot);
+
+  // The accesses to the shared state, queued with deferred
+  void push_hit(long ready, const Request& req);
+  void push_wait(long ready, const Request& req);
+  void send_lower(const Request& req);
+  void evictline_lower(long addr, bool dirty);
+
 };
 
 class CacheSystem {
@@ -227,20 +333,60 @@ public:
   // wait_list contains miss requests with their latencies in
   // cache. When this latency is met, the send_memory function
   // will be called to send the request to the memory system.
-  std::list<std::pair<long, Request> > wait_list;
+  // The requests are sent in arrival order and tick() stops at the
+  // first one that is not due yet, so this stays a FIFO. The waiting
+  // prefetches are also indexed by address for upgrade_prefetch_req().
+  typedef std::list<std::pair<long, Request> > WaitList;
+  WaitList wait_list;
+  std::unordered_map<long, WaitList::iterator> wait_prefetches;
+
+  void push_wait(long ready, const Request& req) {
+    wait_list.push_back(std::make_pair(ready, req));
+    if (req.type == Request::Type::PREFETCH) {
+      // The LLC MSHRs let at most one miss per line wait here
+      assert(wait_prefetches.count(req.addr) == 0);
+      wait_prefetches[req.addr] = std::prev(wait_list.end());
+    }
+  }
 
   // hit_list contains hit requests with their latencies in cache.
   // callback function will be called when this latency is met and
   // set the instruction status to ready in processor's window.
-  std::list<std::pair<long, Request> > hit_list;
+  // It is a min-heap on the cycle the requests are due, and then on
+  // their arrival, so tick() only touches the due ones and completes
+  // them in the order they hit.
+  struct Hit {
+    long ready;
+    long seq;
+    Request req;
+    bool operator>(const Hit& h) const {
+      return (ready != h.ready) ? (ready > h.ready) : (seq > h.seq);
+    }
+  };
+  std::priority_queue<Hit, std::vector<Hit>, std::greater<Hit> > hit_list;
+  long hit_seq = 0;
+
+  void push_hit(long ready, const Request& req) {
+    hit_list.push(Hit{ready, hit_seq++, req});
+  }
 
   std::function<bool(Request)> send_memory;
+  std::function<void(Request)> warm_memory; // see Cache::warm
   std::function<bool(long)> upgrade_prefetch_req_in_mem;
 
   long clk = 0;
   void tick();
   bool upgrade_prefetch_req(long addr);
 
+  bool is_drained() {
+    return wait_list.empty() && hit_list.empty();
+  }
+
+  // The number of upcoming tick() calls that neither send nor complete a
+  // request, and fast-forwarding over them.
+  long get_idle_cycles();
+  void skip(long cycles);
+
   Cache::Level first_level;
   Cache::Level last_level;
 };
@@ -0,0 +1,186 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace ramulator
+{
+
+/* A binary checkpoint of the simulator state at the end of the warmup (see
+ * checkpoint_save and checkpoint_load in Config.h). The checkpoint is taken
+ * once no request is in flight, so it holds no callbacks, only the state that
+ * outlives the requests: the cores and their trace positions, the cache
+ * lines, the DRAM, row and refresh state of the controllers, and the page
+ * table.
+ *
+ * Each class with such state implements checkpoint(Checkpoint&), which both
+ * saves and loads it: io() writes a variable when saving and reads it back
+ * into the same variable when loading, so the two directions cannot diverge.
+ * Sizes that follow from the configuration are written with check(), which
+ * stops a load into a differently configured system. */
+class Checkpoint
+{
+public:
+    Checkpoint(const string& fname, bool saving) : fname(fname), saving(saving)
+    {
+        file = fopen(fname.c_str(), saving ? "wb" : "rb");
+        if (file == nullptr) {
+            cerr << "Error: cannot open the checkpoint " << fname << endl;
+            exit(-1);
+        }
+        long magic = MAGIC;
+        check(magic, "checkpoint format");
+    }
+
+    ~Checkpoint()
+    {
+        fclose(file);
+    }
+
+    bool is_saving() const { return saving; }
+    bool is_loading() const { return !saving; }
+
+    template <typename V>
+    typename enable_if<is_trivially_copyable<V>::value>::type io(V& v)
+    {
+        raw(&v, sizeof(V));
+    }
+
+    // An array of n trivially copyable values
+    template <typename V>
+    void io(V* data, size_t n)
+    {
+        static_assert(is_trivially_copyable<V>::value, "io() of an array of objects");
+        if (n > 0)
+            raw(data, n * sizeof(V));
+    }
+
+    template <typename A, typename B>
+    void io(pair<A, B>& p)
+    {
+        io(p.first);
+        io(p.second);
+    }
+
+    template <typename V>
+    void io(vector<V>& v)
+    {
+        size_t n = v.size();
+        io(n);
+        v.resize(n);
+        io_elements(v, is_trivially_copyable<V>());
+    }
+
+    void io(vector<bool>& v)
+    {
+        size_t n = v.size();
+        io(n);
+        v.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            bool b = v[i];
+            io(b);
+            v[i] = b;
+        }
+    }
+
+    void io(string& s)
+    {
+        size_t n = s.size();
+        io(n);
+        s.resize(n);
+        if (n > 0)
+            raw(&s[0], n);
+    }
+
+    template <typename V>
+    void io(list<V>& l)
+    {
+        size_t n = l.size();
+        io(n);
+        l.resize(n);
+        for (auto& e : l)
+            io(e);
+    }
+
+    template <typename K, typename V>
+    void io(map<K, V>& m)
+    {
+        size_t n = m.size();
+        io(n);
+        if (saving) {
+            for (auto& e : m) {
+                K k = e.first;
+                io(k);
+                io(e.second);
+            }
+            return;
+        }
+        m.clear();
+        for (size_t i = 0; i < n; i++) {
+            K k;
+            V v;
+            io(k);
+            io(v);
+            m.emplace_hint(m.end(), k, v);
+        }
+    }
+
+    // A value that the loading simulator must already have, e.g., a size
+    // given by the configuration
+    template <typename V>
+    void check(V v, const char* what)
+    {
+        V saved = v;
+        io(saved);
+        if (!(saved == v)) {
+            cerr << "Error: the checkpoint " << fname << " was saved with a different "
+                 << what << " than this simulation's." << endl;
+            exit(-1);
+        }
+    }
+
+private:
+    static const long MAGIC = 0x3154504b434d4152; // "RAMCKPT1"
+
+    string fname;
+    bool saving;
+    FILE* file;
+
+    void raw(void* data, size_t size)
+    {
+        size_t n = saving ? fwrite(data, 1, size, file) : fread(data, 1, size, file);
+        if (n != size) {
+            cerr << "Error: cannot " << (saving ? "write" : "read")
+                 << " the checkpoint " << fname << endl;
+            exit(-1);
+        }
+    }
+
+    template <typename V>
+    void io_elements(vector<V>& v, true_type)
+    {
+        if (!v.empty())
+            raw(v.data(), v.size() * sizeof(V));
+    }
+
+    template <typename V>
+    void io_elements(vector<V>& v, false_type)
+    {
+        for (auto& e : v)
+            io(e);
+    }
+};
+
+} /*namespace ramulator*/
+
+#endif /*__CHECKPOINT_H*/
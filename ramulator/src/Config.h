@@ -41,6 +41,13 @@ private:
         {"early_exit", "off"},
         {"expected_limit_insts", "200000000"},
         {"warmup_insts", "100000000"},
+        // checkpoint_save=<file>, checkpoint_load=<file>: share the warmup between simulations (see Checkpoint), no default
+        // sweep=<file>: simulate each line of sim_options (name=value ...) of the file after one shared warmup (see run_sweep), no default
+        {"sweep_jobs", "0"}, // sweep points simulated at a time, 0 for one per CPU the simulation may run on
+        {"sampling", "off"}, // sampled simulation: functional fast-forward between short detailed units (see run_sampled)
+        {"sampling_period_insts", "10000000"}, // instructions per core from the start of a unit to the next
+        {"sampling_warmup_insts", "200000"}, // detailed instructions per core before each unit, not measured
+        {"sampling_unit_insts", "100000"}, // measured instructions per core in each unit
         {"translation", "Random"},
 
         // Cache
@@ -58,15 +65,25 @@ private:
         {"stride_pref_stride_dist", "16"},
 
         // Other
+        {"stats_format", "text"}, // text (gem5 style), json (an object of the values by name) or csv (name,value lines)
+        {"stats_epoch_cycles", "0"}, // also write the change of each value every this many cycles of the simulation to <stats>.epochs, 0 for off
         {"record_cmd_trace", "off"},
         {"print_cmd_trace", "off"},
         {"collect_row_activation_histogram", "off"},
+        {"skip_idle_cycles", "off"}, // fast-forward over cycles in which neither the cores nor the controllers can make progress
+        {"processor_threads", "1"}, // number of threads advancing the cores in parallel (see Processor::tick)
+        {"memory_threads", "1"}, // number of threads ticking the channel controllers in parallel
+        {"trace_reader_thread", "off"}, // read and parse text traces ahead on a background thread per trace (compressed traces always are)
 
         // CROW
         {"crow_entry_evict_hit_threshold", "0"},
         {"crow_evict_fully_restored", "false"},
         {"crow_half_life", "1000"},
         {"crow_to_mru_frac", "0.0f"},
+        {"crow_oracle", "off"}, // also report the CROW table hits with Belady-optimal replacement (see CROWOracle)
+        {"crow_background_copy", "off"}, // copy hot rows while their bank is idle rather than on every CROW table miss (see CROWBackgroundCopy)
+        {"crow_background_copy_threshold", "2"}, // activations after which a row is hot
+        {"crow_replacement", "LRU"}, // LRU, SRRIP, LFU (on the aged hit counts) or TinyLFU (LRU with frequency-based admission)
         {"enable_crow_upperbound", "false"},
         {"enable_tl_dram", "false"},
         {"copy_rows_per_SA", "0"},
@@ -213,6 +230,19 @@ public:
             options[name] = std::to_string(value);
     }
 
+    // Set an option, replacing its value
+    void set (const std::string& name, const std::string& value) {
+        if(use_sim_options)
+            sim_options[name] = value;
+        else
+            options[name] = value;
+    }
+
+    // Set an option that only applies after the warmup (see -c)
+    void set_sim_option (const std::string& name, const std::string& value) {
+        sim_options[name] = value;
+    }
+
     void enable_sim_options () {
         use_sim_options = true;
     }
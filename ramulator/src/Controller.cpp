@@ -8,7 +8,7 @@
 namespace ramulator
 {
 
-static vector<int> get_offending_subarray(DRAM<SALP>* channel, vector<int> & addr_vec){
+static AddrVec get_offending_subarray(DRAM<SALP>* channel, AddrVec & addr_vec){
     int sa_id = 0;
     auto rank = channel->children[addr_vec[int(SALP::Level::Rank)]];
     auto bank = rank->children[addr_vec[int(SALP::Level::Bank)]];
@@ -18,7 +18,7 @@ static vector<int> get_offending_subarray(DRAM<SALP>* channel, vector<int> & add
             sa_id = sa_other->id;
             break;
         }
-    vector<int> offending = addr_vec;
+    AddrVec offending = addr_vec;
     offending[int(SALP::Level::SubArray)] = sa_id;
     offending[int(SALP::Level::Row)] = -1;
     return offending;
@@ -26,7 +26,7 @@ static vector<int> get_offending_subarray(DRAM<SALP>* channel, vector<int> & add
 
 
 template <>
-vector<int> Controller<SALP>::get_addr_vec(SALP::Command cmd, list<Request>::iterator req){
+AddrVec Controller<SALP>::get_addr_vec(SALP::Command cmd, RequestQueue::iterator req){
     if (cmd == SALP::Command::PRE_OTHER)
         return get_offending_subarray(channel, req->addr_vec);
     else
@@ -35,11 +35,11 @@ vector<int> Controller<SALP>::get_addr_vec(SALP::Command cmd, list<Request>::ite
 
 
 template <>
-bool Controller<SALP>::is_ready(list<Request>::iterator req){
+bool Controller<SALP>::is_ready(RequestQueue::iterator req){
     SALP::Command cmd = get_first_cmd(req);
     if (cmd == SALP::Command::PRE_OTHER){
 
-        vector<int> addr_vec = get_offending_subarray(channel, req->addr_vec);
+        AddrVec addr_vec = get_offending_subarray(channel, req->addr_vec);
         return channel->check(cmd, addr_vec.data(), clk);
     }
     else return channel->check(cmd, req->addr_vec.data(), clk);
@@ -194,6 +194,12 @@ void Controller<ALDRAM>::update_temp(ALDRAM::Temp current_temperature){
     channel->spec->aldram_timing(current_temperature);
 }
 
+// The DSARP refresh scheduler picks banks with rand()
+template <>
+bool Controller<DSARP>::supports_parallel_tick(){
+    return false;
+}
+
 
 //template <>
 //void Controller<TLDRAM>::tick(){
@@ -240,7 +246,7 @@ void Controller<ALDRAM>::update_temp(ALDRAM::Temp current_temperature){
 //    if (req == queue->q.end() || !is_ready(req)) {
 //        // we couldn't find a command to schedule -- let's try to be speculative
 //        auto cmd = TLDRAM::Command::PRE;
-//        vector<int> victim = rowpolicy->get_victim(cmd);
+//        AddrVec victim = rowpolicy->get_victim(cmd);
 //        if (!victim.empty()){
 //            issue_cmd(cmd, victim);
 //        }
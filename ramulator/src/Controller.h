@@ -5,6 +5,7 @@
 #include <cstdio>
 #include <deque>
 #include <fstream>
+#include <limits>
 #include <list>
 #include <string>
 #include <vector>
@@ -13,6 +14,7 @@
 #include "DRAM.h"
 #include "Refresh.h"
 #include "Request.h"
+#include "RequestQueue.h"
 #include "Scheduler.h"
 #include "Statistics.h"
 
@@ -21,6 +23,8 @@
 //#include "TLDRAM.h"
 
 #include "CROWTable.h"
+#include "CROWOracle.h"
+#include "CROWBackgroundCopy.h"
 
 using namespace std;
 
@@ -76,6 +80,7 @@ protected:
     ScalarStat crow_num_fr_restore;
     ScalarStat crow_num_hits_with_fr;
     ScalarStat crow_bypass_copying;
+    ScalarStat crow_bypass_admission;
 
     ScalarStat crow_idle_cycle_due_trcd;
     ScalarStat crow_idle_cycle_due_tras;
@@ -106,8 +111,8 @@ public:
     Refresh<T>* refresh;
 
     struct Queue {
-        list<Request> q;
         unsigned int max = 64;
+        RequestQueue q{int(max)};
         unsigned int size() const {return q.size();}
     };
 
@@ -120,8 +125,9 @@ public:
                    // after ACTIVATE w/o READ of WRITE command)
     Queue otherq;  // queue for all "other" requests (e.g., refresh)
 
-    deque<Request> pending;  // read requests that are about to receive data from DRAM
+    RequestQueue pending{64};  // read requests that are about to receive data from DRAM
     bool write_mode = false;  // whether write requests should be prioritized over reads
+    bool draining = false;  // also serve the writes below the watermark once no read waits (see Memory::drain)
     //long refreshed = 0;  // last time refresh requests were generated
 
     /* Command trace for DRAMPower 3.1 */
@@ -131,12 +137,17 @@ public:
     /* Commands to stdout */
     bool print_cmd_trace = false;
 
+    /* Parallel ticking (see Memory::tick) */
+    bool defer_callbacks = false;  // keep completed reads in served instead of calling back
+    vector<Request> served;
+
     bool enable_crow = false;
     bool enable_crow_upperbound = false;
     bool enable_tl_dram = false;
     int crow_evict_threshold = 0;
     int crow_half_life = 0;
     float crow_to_mru_frac = 0.0f;
+    string crow_replacement = "LRU";
     uint crow_table_grouped_SAs = 1;
     uint copy_rows_per_SA = 0;
     uint weak_rows_per_SA = 0;
@@ -148,6 +159,13 @@ public:
     bool is_DDR4 = false, is_LPDDR4 = false; // Hasan
 
     CROWTable<T>* crow_table = nullptr;
+    bool enable_crow_oracle = false;
+    CROWOracle* crow_oracle = nullptr; // records the activations to bound crow_num_hits
+    bool enable_crow_bg_copy = false;
+    int crow_bg_copy_threshold = 2;
+    CROWBackgroundCopy* crow_bg_copy = nullptr; // copy hot rows in idle cycles instead of on demand
+    int crow_bg_copy_next_bank = 0; // round-robin start of issue_background_copy()
+    vector<bool> crow_bg_copy_busy_banks;
     int* ref_counters;
     
     bool refresh_disabled = false;
@@ -404,6 +422,12 @@ public:
             .precision(0)
             ;
 
+        crow_bypass_admission
+            .name("crow_bypass_admission_channel_"+to_string(channel->id) + "_core")
+            .desc("Number of rows not copied to a copy row as the replacement policy did not admit them.")
+            .precision(0)
+            ;
+
         tl_dram_invalidate_due_to_write
             .name("tl_dram_invalidate_due_to_write_channel_"+to_string(channel->id) + "_core")
             .desc("Number of TL-DRAM cached rows invalidated during activation due to pending writes.")
@@ -480,6 +504,8 @@ public:
         cmd_trace_files.clear();
 
         delete crow_table;
+        delete crow_oracle;
+        delete crow_bg_copy;
         delete[] ref_counters;
     }
 
@@ -498,6 +524,9 @@ public:
       // call finish function of each channel
       channel->finish(dram_cycles);
 
+      if(crow_oracle != nullptr)
+          crow_oracle->finish();
+
       // print out the row_act_hist
       if(collect_row_act_histogram) {
           printf("Printing Row Activation Histogram\n");
@@ -538,8 +567,8 @@ public:
         queue.q.push_back(req);
         // shortcut for read requests, if a write to same addr exists
         // necessary for coherence
-        if ((req.type == Request::Type::READ || req.type == Request::Type::PREFETCH) && find_if(writeq.q.begin(), writeq.q.end(),
-                [req](Request& wreq){ return req.addr == wreq.addr;}) != writeq.q.end()){
+        if ((req.type == Request::Type::READ || req.type == Request::Type::PREFETCH)
+                && writeq.q.find(req.addr) != writeq.q.end()){
             req.depart = clk + 1;
             pending.push_back(req);
             readq.q.pop_back();
@@ -548,16 +577,63 @@ public:
         return true;
     }
 
+    // Functional counterpart of enqueue() for the fast-forwarded parts of a
+    // sampled simulation: applies the request to the row buffers, the row
+    // table and the CROW table as if it were served at once, without timing
+    void warm(const Request& req)
+    {
+        typename T::Command cmd = channel->spec->translate[int(req.type)];
+        for (;;) {
+            typename T::Command first = channel->decode(cmd, req.addr_vec.data());
+            if (channel->spec->is_opening(first))
+                warm_crow(req.addr_vec);
+            channel->warm(first, req.addr_vec.data());
+            rowtable->update(first, req.addr_vec, clk);
+            cmd_epoch++;
+            if (first == cmd)
+                break;
+        }
+    }
+
+    // CROW table hits and misses of the demand activations so far
+    long get_crow_hits() { return long(crow_num_hits.value()); }
+    long get_crow_misses() { return long(crow_num_misses.value()); }
+
+    // Whether no request is queued or being served (see Checkpoint)
+    bool is_drained() {
+        return readq.size() == 0 && writeq.size() == 0 && actq.size() == 0 &&
+                otherq.size() == 0 && pending.size() == 0 && served.empty();
+    }
+
+    void checkpoint(Checkpoint& cp) {
+        assert(is_drained() && "Error: cannot checkpoint a controller with requests in flight.");
+
+        cp.io(clk);
+        cp.io(write_mode);
+        channel->checkpoint(cp);
+        rowtable->checkpoint(cp);
+        refresh->checkpoint(cp);
+        scheduler->checkpoint(cp);
+
+        cp.check(crow_table != nullptr, "CROW configuration");
+        if (crow_table != nullptr) {
+            crow_table->checkpoint(cp);
+            cp.io(ref_counters, channel->spec->org_entry.count[int(T::Level::Rank)]);
+        }
+
+        cmd_epoch++;
+    }
+
     bool upgrade_prefetch_req(const Request& req) {
         assert(req.type == Request::Type::READ);
 
         Queue& queue = get_queue(req.type);
 
         // the prefetch request could be in readq, actq, or pending
-        if (upgrade_prefetch_req(queue, req))
+        if (upgrade_prefetch_req(queue.q, req))
             return true;
 
-        if (upgrade_prefetch_req(actq, req))
+        if (upgrade_prefetch_req(actq.q, req))
             return true;
 
         if (upgrade_prefetch_req(pending, req))
@@ -575,7 +651,7 @@ public:
 
         /*** 1. Serve completed reads ***/
         if (pending.size()) {
-            Request& req = pending[0];
+            Request& req = pending.front();
             if (req.depart <= clk) {
                 if (req.depart - req.arrive > 1) { // this request really accessed a row
                   read_latency_sum += req.depart - req.arrive;
@@ -584,7 +660,10 @@ public:
                       req.addr_vec.data(), -1, clk);
                 }
                 
-                req.callback(req);
+                if (defer_callbacks)
+                    served.push_back(req);
+                else
+                    req.callback(req);
                 pending.pop_front();
             }
         }
@@ -596,7 +675,8 @@ public:
         /*** 3. Should we schedule writes? ***/
         if (!write_mode) {
             // yes -- write queue is almost full or read queue is empty
-            if (writeq.size() >= int(0.8 * writeq.max) /*|| readq.size() == 0*/){
+            if (writeq.size() >= int(0.8 * writeq.max) /*|| readq.size() == 0*/ ||
+                    (draining && readq.size() == 0 && writeq.size() != 0)){
                 write_mode = true;
             }
         }
@@ -645,9 +725,11 @@ public:
         if (!is_valid_req) {
             // we couldn't find a command to schedule -- let's try to be speculative
             auto cmd = T::Command::PRE;
-            vector<int> victim = rowpolicy->get_victim(cmd);
+            AddrVec victim = rowpolicy->get_victim(cmd);
             if (!victim.empty())
                 issue_cmd(cmd, victim);
+            else if (crow_bg_copy != nullptr)
+                issue_background_copy();
 
             return;  // nothing more to be done this cycle
         }
@@ -694,8 +776,12 @@ public:
 
         bool make_crow_copy = true;
         if (enable_crow && channel->spec->is_opening(cmd)) {
-            vector<int> target_addr_vec = get_addr_vec(cmd, req);
-            if(!crow_table->is_hit(target_addr_vec) && crow_table->is_full(target_addr_vec)) {
+            AddrVec target_addr_vec = get_addr_vec(cmd, req);
+            if(crow_bg_copy != nullptr && !crow_table->is_hit(target_addr_vec)) {
+                // the row is copied later in the background if it is hot
+                make_crow_copy = false;
+            }
+            else if(!crow_table->is_hit(target_addr_vec) && crow_table->is_full(target_addr_vec)) {
                 bool discard_next = true;
 
                 if(prioritize_evict_fully_restored) {
@@ -703,12 +789,17 @@ public:
                 }
 
                 if(discard_next) {
-                    CROWEntry* cur_entry = crow_table->get_LRU_entry(target_addr_vec, crow_evict_threshold);
+                    bool rejected;
+                    CROWEntry* cur_entry = crow_table->get_victim_entry(target_addr_vec, crow_evict_threshold,
+                            &rejected);
                     
                     if(cur_entry == nullptr) {
                         assert(!enable_tl_dram && "Error: It should always be possible to discard an entry with TL-DRAM.");
                         make_crow_copy = false;
-                        crow_bypass_copying++;
+                        if(rejected)
+                            crow_bypass_admission++;
+                        else
+                            crow_bypass_copying++;
                     }
                     else {
                         if(cur_entry->FR && !enable_tl_dram) {
@@ -722,9 +813,9 @@ public:
                             crow_full_restore++;
                             return;
                         } else {
-                            // move to LRU
+                            // make it the next entry to evict
                             target_addr_vec[int(T::Level::Row)] = cur_entry->row_addr;
-                            crow_table->make_LRU(target_addr_vec, cur_entry);
+                            crow_table->make_victim(target_addr_vec, cur_entry);
                             crow_skip_full_restore++;
                         }
                     }
@@ -740,7 +831,7 @@ public:
         }
 
         if((enable_crow && enable_tl_dram) && ((cmd == T::Command::WR) || (cmd == T::Command::WRA))) {
-            vector<int> target_addr_vec = get_addr_vec(cmd, req);
+            AddrVec target_addr_vec = get_addr_vec(cmd, req);
             target_addr_vec[int(T::Level::Row)] = rowtable->get_open_row(target_addr_vec);
 
             CROWEntry* cur_entry = crow_table->get_hit_entry(target_addr_vec);
@@ -785,8 +876,95 @@ public:
         queue->q.erase(req);
     }
 
+    // Whether tick() can run concurrently with the other channels' tick()
+    // (printing commands to stdout would interleave them)
+    bool supports_parallel_tick()
+    {
+        return !print_cmd_trace;
+    }
+
+    // Prepares tick() to run on a worker thread concurrently with the other
+    // channels: tick() then touches nothing outside of this controller
+    void set_parallel_tick(bool enable)
+    {
+        defer_callbacks = enable;
+        if (crow_table != nullptr)
+            crow_table->defer_insertion = enable;
+    }
+
+    // Completes a parallel tick() on the main thread, in channel order, so
+    // that callbacks and random numbers are processed exactly as in a
+    // serial run
+    void finish_parallel_tick()
+    {
+        for (auto& req : served)
+            req.callback(req);
+        served.clear();
+        if (crow_table != nullptr)
+            crow_table->finish_add_entry();
+    }
+
+    // The earliest clock at which tick() may do more than advance the clock
+    // and the per-cycle queue statistics: serving a completed read, injecting
+    // a refresh, or issuing any command. The cycles before it can be skipped.
+    long get_next_event()
+    {
+        // these schedulers update their own state on every get_head()
+        if (scheduler->type == Scheduler<T>::Type::BLISS ||
+                scheduler->type == Scheduler<T>::Type::PARBS)
+            return clk + 1;
+
+        // and background copies are issued in otherwise idle cycles
+        if (crow_bg_copy != nullptr)
+            return clk + 1;
+
+        long next_event = numeric_limits<long>::max();
+
+        if (pending.size())
+            next_event = min(next_event, pending.front().depart);
+
+        if (!refresh_disabled)
+            next_event = min(next_event, clk + refresh->get_next_refresh() - refresh->clk);
+
+        for (auto queue : {&actq, &otherq, &readq, &writeq}) {
+            for (auto req = queue->q.begin(); req != queue->q.end(); req++) {
+                next_event = min(next_event, get_next_ready(get_first_cmd(req), req->addr_vec));
+                if (next_event <= clk + 1)
+                    return clk + 1;
+            }
+        }
+
+        next_event = min(next_event, rowpolicy->get_next_victim(T::Command::PRE));
+
+        return max(next_event, clk + 1);
+    }
+
+    // The earliest clock at which is_ready(cmd, addr_vec) holds, assuming no
+    // other command is issued in between. A closing command blocked by a
+    // just opened bank never becomes ready on its own.
+    long get_next_ready(typename T::Command cmd, const AddrVec& addr_vec)
+    {
+        long next_clk = max(clk + 1, channel->get_next(cmd, addr_vec.data()));
+        if (!channel->check_iteratively(cmd, addr_vec.data(), next_clk))
+            return numeric_limits<long>::max();
+        return next_clk;
+    }
+
+    // Fast-forward over cycles for which get_next_event() guarantees that
+    // tick() would only update the clocks and the queue length statistics
+    void skip(long cycles)
+    {
+        clk += cycles;
+        req_queue_length_sum += cycles * (readq.size() + writeq.size() + pending.size());
+        read_req_queue_length_sum += cycles * (readq.size() + pending.size());
+        write_req_queue_length_sum += cycles * writeq.size();
+
+        if (!refresh_disabled)
+            refresh->clk += cycles;
+    }
+
     // CROW
-    bool req_hold_due_trcd(list<Request>& q) {
+    bool req_hold_due_trcd(RequestQueue& q) {
         // go over all requests in 'q' and check if there is one that could
         // have been issued if tRCD was 0.
         
@@ -798,7 +976,7 @@ public:
         return false;
     }
 
-    bool req_hold_due_tras(list<Request>& q) {
+    bool req_hold_due_tras(RequestQueue& q) {
         // go over all requests in 'q' and check if there is one that could
         // have been issued if tRAS was 0.
         
@@ -810,7 +988,7 @@ public:
         return false;
     }
 
-    bool is_ready_no_trcd(list<Request>::iterator req) {
+    bool is_ready_no_trcd(RequestQueue::iterator req) {
         typename T::Command cmd = get_first_cmd(req);
 
         if(!channel->spec->is_accessing(cmd))
@@ -819,7 +997,7 @@ public:
         return channel->check_no_trcd(cmd, req->addr_vec.data(), clk);
     }
 
-    bool is_ready_no_tras(list<Request>::iterator req) {
+    bool is_ready_no_tras(RequestQueue::iterator req) {
         typename T::Command cmd = get_first_cmd(req);
 
         if(cmd != T::Command::PRE)
@@ -829,37 +1007,52 @@ public:
     }
     // END - CROW
 
-    bool is_ready(list<Request>::iterator req)
+    bool is_ready(RequestQueue::iterator req)
     {
         typename T::Command cmd = get_first_cmd(req);
-        return channel->check_iteratively(cmd, req->addr_vec.data(), clk);
+        BankMemo* memo = get_bank_memo(req->addr_vec);
+        if (memo == nullptr)
+            return channel->check_iteratively(cmd, req->addr_vec.data(), clk);
+
+        if (memo->ready_epoch[int(cmd)] != cmd_epoch || memo->ready_clk[int(cmd)] != clk) {
+            memo->ready[int(cmd)] = channel->check_iteratively(cmd, req->addr_vec.data(), clk);
+            memo->ready_epoch[int(cmd)] = cmd_epoch;
+            memo->ready_clk[int(cmd)] = clk;
+        }
+        return memo->ready[int(cmd)];
     }
 
-    bool is_ready(typename T::Command cmd, const vector<int>& addr_vec)
+    bool is_ready(typename T::Command cmd, const AddrVec& addr_vec)
     {
         return channel->check_iteratively(cmd, addr_vec.data(), clk);
     }
 
-    bool is_row_hit(list<Request>::iterator req)
+    bool is_row_hit(RequestQueue::iterator req)
     {
         // cmd must be decided by the request type, not the first cmd
         typename T::Command cmd = channel->spec->translate[int(req->type)];
-        return channel->check_row_hit(cmd, req->addr_vec.data());
+        BankMemo* memo = get_row_memo(cmd, req->addr_vec);
+        if (memo == nullptr)
+            return channel->check_row_hit(cmd, req->addr_vec.data());
+        return memo->row_hit;
     }
 
-    bool is_row_hit(typename T::Command cmd, const vector<int>& addr_vec)
+    bool is_row_hit(typename T::Command cmd, const AddrVec& addr_vec)
     {
         return channel->check_row_hit(cmd, addr_vec.data());
     }
 
-    bool is_row_open(list<Request>::iterator req)
+    bool is_row_open(RequestQueue::iterator req)
     {
         // cmd must be decided by the request type, not the first cmd
         typename T::Command cmd = channel->spec->translate[int(req->type)];
-        return channel->check_row_open(cmd, req->addr_vec.data());
+        BankMemo* memo = get_row_memo(cmd, req->addr_vec);
+        if (memo == nullptr)
+            return channel->check_row_open(cmd, req->addr_vec.data());
+        return memo->row_open;
     }
 
-    bool is_row_open(typename T::Command cmd, const vector<int>& addr_vec)
+    bool is_row_open(typename T::Command cmd, const AddrVec& addr_vec)
     {
         return channel->check_row_open(cmd, addr_vec.data());
     }
@@ -895,8 +1088,10 @@ public:
     void reload_options(const Config& configs) {
 
         if((channel->spec->standard_name == "SALP-MASA") || (channel->spec->standard_name == "SALP-1") || 
-                (channel->spec->standard_name == "SALP-2"))
+                (channel->spec->standard_name == "SALP-2")) {
             channel->update_num_subarrays(configs.get_int("subarrays"));
+            update_num_banks();
+        }
 
         prioritize_evict_fully_restored = configs.get_bool("crow_evict_fully_restored");
         collect_row_act_histogram = configs.get_bool("collect_row_activation_histogram");
@@ -906,6 +1101,10 @@ public:
         crow_evict_threshold = configs.get_int("crow_entry_evict_hit_threshold");
         crow_half_life = configs.get_int("crow_half_life");
         crow_to_mru_frac = configs.get_float("crow_to_mru_frac");
+        crow_replacement = configs.get_str("crow_replacement");
+        enable_crow_oracle = configs.get_bool("crow_oracle");
+        enable_crow_bg_copy = configs.get_bool("crow_background_copy");
+        crow_bg_copy_threshold = configs.get_int("crow_background_copy_threshold");
         crow_table_grouped_SAs = configs.get_int("crow_table_grouped_SAs");
         
         refresh_disabled = configs.get_bool("disable_refresh"); 
@@ -919,6 +1118,8 @@ public:
         }
 
         enable_tl_dram = configs.get_bool("enable_tl_dram");
+        assert(!(enable_tl_dram && crow_replacement == "TinyLFU") &&
+                "Error: TL-DRAM must always be able to copy a row, which TinyLFU may reject.");
 
         if(enable_crow || enable_crow_upperbound) {
 
@@ -948,19 +1149,258 @@ public:
 
 
 private:
-    typename T::Command get_first_cmd(list<Request>::iterator req)
+    typename T::Command get_first_cmd(RequestQueue::iterator req)
     {
         typename T::Command cmd = channel->spec->translate[int(req->type)];
-        return channel->decode_iteratively(cmd, req->addr_vec.data());
+        BankMemo* memo = get_row_memo(cmd, req->addr_vec);
+        if (memo == nullptr)
+            return channel->decode_iteratively(cmd, req->addr_vec.data());
+        return memo->first_cmd;
+    }
+
+    /* Per-bank memo of the queries the scheduler makes for every queued
+     * request on every tick. A bank here is a leaf of the DRAM tree (the
+     * level above Row). The first command, row hit and row open of a request
+     * only depend on the state of the nodes on the way to its bank and on its
+     * row and command, and readiness additionally on the clock. The state
+     * only changes when a command is issued, which bumps cmd_epoch and so
+     * invalidates the memo. Each bank remembers the last row/command it was
+     * queried for, as most of the requests queued to a bank target one row. */
+    struct BankMemo {
+        long row_epoch = -1;
+        int row = -1;
+        typename T::Command cmd;
+        typename T::Command first_cmd;
+        bool row_hit = false, row_open = false;
+
+        long ready_epoch[int(T::Command::MAX)];
+        long ready_clk[int(T::Command::MAX)];
+        bool ready[int(T::Command::MAX)];
+
+        BankMemo() {
+            fill_n(ready_epoch, int(T::Command::MAX), -1);
+        }
+    };
+    vector<BankMemo> bank_memos;
+    long cmd_epoch = 0;
+
+    // nullptr for addresses that do not name a bank (e.g., refreshes)
+    BankMemo* get_bank_memo(const AddrVec& addr_vec)
+    {
+        int bank = get_bank_index(addr_vec);
+        if (bank < 0)
+            return nullptr;
+        if (bank_memos.empty())
+            bank_memos.resize(get_num_banks());
+        return &bank_memos[bank];
+    }
+
+    int num_banks = 0;
+    int bank_fanout[int(T::Level::MAX)];
+
+    // Recounts the banks once the DRAM tree grew and moves the per-bank state
+    // to the new bank indices. The background copy state is rebuilt for the
+    // new count by initialize_crow(), which reload_options() calls next.
+    void update_num_banks()
+    {
+        if (!num_banks)
+            return; // not counted yet
+        num_banks = 0;
+        get_num_banks();
+        bank_memos.clear();
+        rowtable->reindex();
+        crow_bg_copy_busy_banks.clear();
+        crow_bg_copy_next_bank = 0;
+    }
+
+public:
+    // The number of banks (leaves of the DRAM tree above the rows) in the
+    // channel. Counted on first use and again when SALP adds subarrays in
+    // reload_options() (see update_num_banks()).
+    int get_num_banks()
+    {
+        if (!num_banks) {
+            num_banks = 1;
+            DRAM<T>* node = channel;
+            for (int l = int(T::Level::Channel) + 1; l < int(T::Level::Row); l++) {
+                bank_fanout[l] = node->children.size();
+                num_banks *= bank_fanout[l];
+                node = node->children[0];
+            }
+        }
+        return num_banks;
+    }
+
+    // The index (in address order) of the bank addr_vec falls into, or -1 if
+    // it does not name a single bank (e.g., a rank-wide refresh)
+    int get_bank_index(const AddrVec& addr_vec)
+    {
+        get_num_banks();
+        int bank = 0;
+        for (int l = int(T::Level::Channel) + 1; l < int(T::Level::Row); l++) {
+            if (addr_vec[l] < 0)
+                return -1;
+            bank = bank * bank_fanout[l] + addr_vec[l];
+        }
+        return bank;
+    }
+
+private:
+
+    BankMemo* get_row_memo(typename T::Command cmd, const AddrVec& addr_vec)
+    {
+        BankMemo* memo = get_bank_memo(addr_vec);
+        if (memo == nullptr)
+            return nullptr;
+
+        int row = addr_vec[int(T::Level::Row)];
+        if (memo->row_epoch != cmd_epoch || memo->row != row || memo->cmd != cmd) {
+            memo->row_epoch = cmd_epoch;
+            memo->row = row;
+            memo->cmd = cmd;
+            memo->first_cmd = channel->decode_iteratively(cmd, addr_vec.data());
+            memo->row_hit = channel->check_row_hit(cmd, addr_vec.data());
+            memo->row_open = channel->check_row_open(cmd, addr_vec.data());
+        }
+        return memo;
+    }
+
+    // Called when there is no command to schedule and nothing to close:
+    // precharges a bank a background copy left open, or copies the hot row
+    // of an idle bank into the CROW table, into a free copy row or in place
+    // of a row that was not hit recently. Banks with queued requests are
+    // left alone, and so is the whole channel while a refresh waits.
+    void issue_background_copy()
+    {
+        if (otherq.size())
+            return;
+
+        int num_banks = get_num_banks();
+        crow_bg_copy_busy_banks.assign(num_banks, false);
+        for (Queue* queue : {&readq, &writeq, &actq}) {
+            for (auto& req : queue->q) {
+                int bank = get_bank_index(req.addr_vec);
+                if (bank >= 0)
+                    crow_bg_copy_busy_banks[bank] = true;
+            }
+        }
+
+        for (int i = 0; i < num_banks; i++) {
+            int bank = (crow_bg_copy_next_bank + i) % num_banks;
+            if (crow_bg_copy_busy_banks[bank])
+                continue;
+
+            if (crow_bg_copy->opened[bank]) {
+                const AddrVec& opened_addr_vec = crow_bg_copy->opened_addr_vecs[bank];
+                if (!channel->check_row_open(T::Command::RD, opened_addr_vec.data())) {
+                    crow_bg_copy->opened[bank] = false;
+                } else {
+                    if (is_ready(T::Command::PRE, opened_addr_vec)) {
+                        issue_cmd(T::Command::PRE, opened_addr_vec, false, true, true);
+                        crow_bg_copy->opened[bank] = false;
+                        crow_bg_copy_next_bank = (bank + 1) % num_banks;
+                        return;
+                    }
+                    continue;
+                }
+            }
+
+            AddrVec addr_vec;
+            if (!crow_bg_copy->get_candidate(bank, addr_vec))
+                continue;
+
+            int row = addr_vec[int(T::Level::Row)];
+            if (crow_table->is_hit(addr_vec)) {
+                crow_bg_copy->clear_candidate(bank, row);
+                continue;
+            }
+
+            if (channel->check_row_open(T::Command::RD, addr_vec.data()) ||
+                    !is_ready(T::Command::ACT, addr_vec))
+                continue;
+
+            if (crow_table->is_full(addr_vec)) {
+                bool rejected;
+                CROWEntry* victim = crow_table->get_victim_entry(addr_vec, crow_evict_threshold, &rejected);
+                if (victim == nullptr || victim->FR || victim->hit_count > 0) {
+                    if (rejected)
+                        crow_bg_copy->crow_bg_copy_rejected++;
+                    else if (victim == nullptr)
+                        crow_bg_copy->crow_bg_copy_no_victim++;
+                    else if (victim->FR)
+                        crow_bg_copy->crow_bg_copy_victim_fr++;
+                    else
+                        crow_bg_copy->crow_bg_copy_victim_hit++;
+                    crow_bg_copy->clear_candidate(bank, row);
+                    continue;
+                }
+
+                AddrVec victim_addr_vec = addr_vec;
+                victim_addr_vec[int(T::Level::Row)] = victim->row_addr;
+                crow_table->make_victim(victim_addr_vec, victim);
+            }
+
+            issue_cmd(T::Command::ACT, addr_vec, false, true, true);
+            crow_bg_copy->clear_candidate(bank, row);
+            crow_bg_copy->opened[bank] = true;
+            crow_bg_copy->opened_addr_vecs[bank] = addr_vec;
+            crow_bg_copy_next_bank = (bank + 1) % num_banks;
+            return;
+        }
+    }
+
+    // The CROW table side of an activation in warm(): the same copy
+    // decisions as tick() and issue_cmd(), where restoring the victim
+    // fully takes no time either
+    void warm_crow(const AddrVec& addr_vec)
+    {
+        if (!enable_crow)
+            return;
+
+        if (crow_table->is_hit(addr_vec)) {
+            crow_table->access(addr_vec);
+            return;
+        }
+
+        if (crow_bg_copy != nullptr) {
+            crow_table->access(addr_vec);
+            crow_bg_copy->record(crow_table->get_set_index(addr_vec), get_bank_index(addr_vec),
+                    addr_vec, addr_vec[int(T::Level::Row)]);
+            return;
+        }
+
+        if (crow_table->is_full(addr_vec)) {
+            CROWEntry* victim = crow_table->get_victim_entry(addr_vec, crow_evict_threshold);
+            if (victim == nullptr) {
+                crow_table->access(addr_vec);
+                return;
+            }
+
+            AddrVec victim_addr_vec = addr_vec;
+            victim_addr_vec[int(T::Level::Row)] = victim->row_addr;
+            victim->FR = false;
+            crow_table->make_victim(victim_addr_vec, victim);
+        }
+
+        crow_table->add_entry(addr_vec, false);
+        crow_table->finish_add_entry();
     }
 
     unsigned long last_clk = 0; // DEBUG
     unsigned long num_cas_cmds = 0;
-    void issue_cmd(typename T::Command cmd, const vector<int>& addr_vec, bool do_full_restore = false, bool make_crow_copy = true)
+    void issue_cmd(typename T::Command cmd, const AddrVec& addr_vec, bool do_full_restore = false, bool make_crow_copy = true,
+            bool background_copy = false)
     {
         assert(is_ready(cmd, addr_vec));
 
-        if(warmup_complete && collect_row_act_histogram) {
+        if(crow_bg_copy != nullptr && !background_copy) {
+            // a demand command takes over a bank a background copy opened
+            int bank = get_bank_index(addr_vec);
+            if(bank >= 0)
+                crow_bg_copy->opened[bank] = false;
+        }
+
+        if(warmup_complete && collect_row_act_histogram && !background_copy) {
             if(channel->spec->is_opening(cmd)) {
                 int row_id = addr_vec[int(T::Level::Row)];
                 int SA_size = channel->spec->org_entry.count[int(T::Level::Row)]/num_SAs;
@@ -984,6 +1424,9 @@ private:
 
         if(enable_crow || enable_crow_upperbound) {
             if(channel->spec->is_opening(cmd)) {
+                if(crow_oracle != nullptr && !do_full_restore && !background_copy)
+                    crow_oracle->record(crow_table->get_set_index(addr_vec), addr_vec[int(T::Level::Row)]);
+
                 if(enable_crow_upperbound || crow_table->is_hit(addr_vec)) {
                     assert(make_crow_copy && "Error: A row activation without copying should not hit on CROWTable!");
 
@@ -1021,9 +1464,16 @@ private:
                         crow_num_copies++;
                     } else {
                         crow_table->access(addr_vec); // we know it is a miss but we access to update the hit_count of the LRU entry
+
+                        if(crow_bg_copy != nullptr)
+                            crow_bg_copy->record(crow_table->get_set_index(addr_vec), get_bank_index(addr_vec),
+                                    addr_vec, addr_vec[int(T::Level::Row)]);
                     }
-                    
-                    crow_num_misses++;
+
+                    if(background_copy)
+                        crow_bg_copy->crow_bg_copies++;
+                    else
+                        crow_num_misses++;
                 }
             }
 
@@ -1117,9 +1567,11 @@ private:
         // END - CROW
         
         channel->update(cmd, addr_vec.data(), clk);
+        cmd_epoch++;
 
-        if(enable_crow && do_full_restore && (cmd == T::Command::ACT)) {
-            // clean just_opened state
+        if(enable_crow && (do_full_restore || background_copy) && (cmd == T::Command::ACT)) {
+            // clean just_opened state, as no column command follows these
+            // activations
             if(is_LPDDR4) {
                 channel->children[addr_vec[int(T::Level::Rank)]]->
                     children[addr_vec[int(T::Level::Bank)]]->just_opened = false;
@@ -1174,7 +1626,7 @@ private:
             printf("\n");
         }
     }
-    vector<int> get_addr_vec(typename T::Command cmd, list<Request>::iterator req){
+    AddrVec get_addr_vec(typename T::Command cmd, RequestQueue::iterator req){
         return req->addr_vec;
     }
 
@@ -1225,7 +1677,26 @@ private:
 
         crow_table = new CROWTable<T>(channel->spec, channel->id, num_SAs, copy_rows_per_SA, 
                 weak_rows_per_SA, crow_evict_threshold, crow_half_life, crow_to_mru_frac,
-                crow_table_grouped_SAs);
+                crow_table_grouped_SAs, crow_replacement);
+        crow_table->defer_insertion = defer_callbacks;
+
+        if(crow_oracle != nullptr)
+            delete crow_oracle;
+        crow_oracle = nullptr;
+
+        if(enable_crow_oracle)
+            crow_oracle = new CROWOracle(channel->id, crow_table->get_num_sets(),
+                    copy_rows_per_SA - weak_rows_per_SA);
+
+        if(crow_bg_copy != nullptr)
+            delete crow_bg_copy;
+        crow_bg_copy = nullptr;
+
+        if(enable_crow_bg_copy) {
+            assert(!enable_tl_dram && "Error: TL-DRAM copies every activated row on demand.");
+            crow_bg_copy = new CROWBackgroundCopy(channel->id, crow_table->get_num_sets(),
+                    get_num_banks(), crow_bg_copy_threshold);
+        }
 
         ref_counters = new int[channel->spec->org_entry.count[int(T::Level::Rank)]];
         for(int i = 0; i < channel->spec->org_entry.count[int(T::Level::Rank)]; i++)
@@ -1359,10 +1830,10 @@ private:
         }
     }
 
-    void crow_set_FR_on_PRE(typename T::Command cmd, const vector<int>& addr_vec) {
+    void crow_set_FR_on_PRE(typename T::Command cmd, const AddrVec& addr_vec) {
         
         if(cmd != T::Command::PRE) {
-            vector<int> cur_addr_vec = addr_vec;
+            AddrVec cur_addr_vec = addr_vec;
 
             int bank_levels = int(T::Level::Bank) - int(T::Level::Rank);
 
@@ -1394,7 +1865,7 @@ private:
 
     }
 
-    void crow_set_FR_on_PRE_single_bank(const vector<int>& addr_vec) {
+    void crow_set_FR_on_PRE_single_bank(const AddrVec& addr_vec) {
         
         // get the id of the row to be precharged
         int pre_row = rowtable->get_open_row(addr_vec);
@@ -1475,31 +1946,13 @@ private:
 
     }
 
-    bool upgrade_prefetch_req (Queue& q, const Request& req) {
+    bool upgrade_prefetch_req (RequestQueue& q, const Request& req) {
         if(q.size() == 0)
             return false;
 
-        auto pref_req = find_if(q.q.begin(), q.q.end(), [req](Request& preq) {
-                                                return req.addr == preq.addr;});
-
-        if (pref_req != q.q.end()) {
-            pref_req->type = Request::Type::READ;
-            pref_req->callback = pref_req->proc_callback; // FIXME: proc_callback is an ugly workaround
-            return true;
-        }
-            
-        return false;
-    }
-
-    // FIXME: ugly
-    bool upgrade_prefetch_req (deque<Request>& p, const Request& req) {
-        if (p.size() == 0)
-            return false;
-
-        auto pref_req = find_if(p.begin(), p.end(), [req](Request& preq) {
-                                                return req.addr == preq.addr;});
+        auto pref_req = q.find(req.addr);
 
-        if (pref_req != p.end()) {
+        if (pref_req != q.end()) {
             pref_req->type = Request::Type::READ;
             pref_req->callback = pref_req->proc_callback; // FIXME: proc_callback is an ugly workaround
             return true;
@@ -1527,11 +1980,11 @@ private:
 };
 
 template <>
-vector<int> Controller<SALP>::get_addr_vec(
-    SALP::Command cmd, list<Request>::iterator req);
+AddrVec Controller<SALP>::get_addr_vec(
+    SALP::Command cmd, RequestQueue::iterator req);
 
 template <>
-bool Controller<SALP>::is_ready(list<Request>::iterator req);
+bool Controller<SALP>::is_ready(RequestQueue::iterator req);
 
 template <>
 void Controller<SALP>::initialize_crow_timing(vector<SALP::TimingEntry> timing[]
@@ -1544,6 +1997,9 @@ void Controller<SALP>::initialize_crow_timing(vector<SALP::TimingEntry> timing[]
 template <>
 void Controller<ALDRAM>::update_temp(ALDRAM::Temp current_temperature);
 
+template <>
+bool Controller<DSARP>::supports_parallel_tick();
+
 //template <>
 //void Controller<TLDRAM>::tick();
 
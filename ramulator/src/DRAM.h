@@ -2,9 +2,10 @@
 #define __DRAM_H
 
 #include "Statistics.h"
+#include "AddrVec.h"
+#include "Checkpoint.h"
 #include <iostream>
 #include <vector>
-#include <deque>
 #include <map>
 #include <functional>
 #include <algorithm>
@@ -16,9 +17,50 @@ using namespace std;
 namespace ramulator
 {
 
+/* The states of the rows that a bank (or an equivalent entity) has open, with
+ * the part of the map<int, State> interface the standards use. A bank opens
+ * one row at a time (a few at most), so the rows are kept in a flat array
+ * that is searched linearly and reused after clear(), rather than in map
+ * nodes allocated on every activation. */
+template <typename State>
+class RowStates
+{
+public:
+    typedef pair<int, State>* iterator;
+
+    iterator begin() { return rows.data(); }
+    iterator end() { return rows.data() + rows.size(); }
+    size_t size() const { return rows.size(); }
+    void clear() { rows.clear(); }
+
+    iterator find(int row)
+    {
+        for (auto it = begin(); it != end(); it++)
+            if (it->first == row)
+                return it;
+        return end();
+    }
+
+    State& operator[](int row)
+    {
+        auto it = find(row);
+        if (it != end())
+            return it->second;
+        rows.emplace_back(row, State());
+        return rows.back().second;
+    }
+
+    void checkpoint(Checkpoint& cp) { cp.io(rows); }
+
+private:
+    vector<pair<int, State>> rows;
+};
+
 template <typename T>
 class DRAM
 {
+    static_assert(int(T::Level::MAX) <= AddrVec::CAPACITY,
+            "AddrVec::CAPACITY is too small for this standard's levels");
 public:
     ScalarStat active_cycles;
     ScalarStat refresh_cycles;
@@ -59,7 +101,7 @@ public:
     // State of Rows:
     // There are too many rows for them to be instantiated individually
     // Instead, their bank (or an equivalent entity) tracks their state for them
-    map<int, typename T::State> row_state;
+    RowStates<typename T::State> row_state;
 
     // Insert a node as one of my child nodes
     void insert(DRAM<T>* child);
@@ -90,13 +132,16 @@ public:
 
     // Update the timing/state of the tree, signifying that a command has been issued
     void update(typename T::Command cmd, const int* addr, long clk);
+    // Update only the state of the tree, as if the command took no time
+    // (functional warming in sampled simulation)
+    void warm(typename T::Command cmd, const int* addr) { update_state(cmd, addr, cur_clk); }
     // Update statistics:
 
     // Update the number of requests it serves currently
     void update_serving_requests(const int* addr, int delta, long clk);
 
     // CROW
-    int cycles_since_last_act(const vector<int>& addr_vec, long clk) {
+    int cycles_since_last_act(const AddrVec& addr_vec, long clk) {
         
         return cycles_since_last_act(addr_vec.data(), clk);
 
@@ -104,8 +149,8 @@ public:
 
     int cycles_since_last_act(const int* addr, long clk) {
         if(level == spec->scope[int(T::Command::ACT)] || !children.size()){
-            assert(prev[int(T::Command::ACT)].size() == 1);
-            return (clk - prev[int(T::Command::ACT)][0]);
+            assert(prev_len[int(T::Command::ACT)] == 1);
+            return (clk - prev(T::Command::ACT, 0));
         } else
             return children[addr[int(level) + 1]]->cycles_since_last_act(addr, clk);
     }
@@ -137,27 +182,60 @@ public:
     
     void finish(long dram_cycles);
 
+    // Save or load the state and timing of this node and its children
+    void checkpoint(Checkpoint& cp);
+
 private:
     // Constructor
     DRAM(){}
 
     // Timing
     long next[int(T::Command::MAX)]; // the earliest time in the future when a command could be ready
-    deque<long> prev[int(T::Command::MAX)]; // the most recent history of when commands were issued
+
+    // The most recent history of when commands were issued. For each command,
+    // a ring buffer of its last prev_len issue times (as many as the longest
+    // distance of its timing parameters), the most recent one at prev_head.
+    // The buffers of all commands share one contiguous array.
+    vector<long> prev_clk;
+    int prev_offset[int(T::Command::MAX)];
+    int prev_len[int(T::Command::MAX)];
+    int prev_head[int(T::Command::MAX)];
+
+    // The issue time of the dist-th most recent cmd (0 is the most recent)
+    long prev(typename T::Command cmd, int dist) const
+    {
+        int c = int(cmd);
+        int i = prev_head[c] + dist;
+        if (i >= prev_len[c])
+            i -= prev_len[c];
+        return prev_clk[prev_offset[c] + i];
+    }
+
+    void push_prev(typename T::Command cmd, long clk)
+    {
+        int c = int(cmd);
+        prev_head[c] = (prev_head[c] == 0 ? prev_len[c] : prev_head[c]) - 1;
+        prev_clk[prev_offset[c] + prev_head[c]] = clk;
+    }
+
+    // The lookup tables below are the rows of the standard's tables for my
+    // level. They hold plain function pointers (the standards fill them with
+    // captureless lambdas), so a lookup is a single indirect call without
+    // std::function's type erasure.
 
     // Lookup table for which commands must be preceded by which other commands (i.e., "prerequisite")
     // E.g., a read command to a closed bank must be preceded by an activate command
-    function<typename T::Command(DRAM<T>*, typename T::Command cmd, int)>* prereq;
+    typename T::Command (**prereq)(DRAM<T>*, typename T::Command cmd, int);
 
     // SAUGATA: added table for row hits
     // Lookup table for whether a command is a row hit
     // E.g., a read command to a closed bank must be preceded by an activate command
-    function<bool(DRAM<T>*, typename T::Command cmd, int)>* rowhit;
-    function<bool(DRAM<T>*, typename T::Command cmd, int)>* rowopen;
+    bool (**rowhit)(DRAM<T>*, typename T::Command cmd, int);
+    bool (**rowopen)(DRAM<T>*, typename T::Command cmd, int);
 
     // Lookup table between commands and the state transitions they trigger
     // E.g., an activate command to a closed bank opens both the bank and the row
-    function<void(DRAM<T>*, int)>* lambda;
+    void (**lambda)(DRAM<T>*, int);
 
     // Lookup table for timing parameters
     // E.g., activate->precharge: tRAS@bank, activate->activate: tRC@bank
@@ -239,6 +317,32 @@ void DRAM<T>::finish(long dram_cycles) {
   }
 }
 
+template <typename T>
+void DRAM<T>::checkpoint(Checkpoint& cp) {
+  cp.check(children.size(), "DRAM organization");
+  cp.check(prev_clk.size(), "DRAM timing");
+
+  cp.io(state);
+  row_state.checkpoint(cp);
+  cp.io(just_opened);
+  cp.io(cur_clk);
+  cp.io(next);
+  cp.io(prev_clk);
+  cp.io(prev_head);
+
+  cp.io(cur_serving_requests);
+  cp.io(begin_of_serving);
+  cp.io(end_of_serving);
+  cp.io(begin_of_cur_reqcnt);
+  cp.io(begin_of_refreshing);
+  cp.io(end_of_refreshing);
+  cp.io(refresh_intervals);
+
+  for (auto child : children) {
+    child->checkpoint(cp);
+  }
+}
+
 // Constructor
 template <typename T>
 DRAM<T>::DRAM(T* spec, typename T::Level level) :
@@ -258,8 +362,10 @@ DRAM<T>::DRAM(T* spec, typename T::Level level) :
         for (auto& t : timing[cmd])
             dist = max(dist, t.dist);
 
-        if (dist)
-            prev[cmd].resize(dist, -1); // initialize history
+        prev_offset[cmd] = prev_clk.size();
+        prev_len[cmd] = dist;
+        prev_head[cmd] = 0;
+        prev_clk.resize(prev_clk.size() + dist, -1); // initialize history
     }
 
     // try to recursively construct my children
@@ -462,17 +568,17 @@ template <typename T>
 bool DRAM<T>::check_no_tras(typename T::Command cmd, const int* addr, long clk) {
 
     if(((is_DDR4 || is_LPDDR4) && level == T::Level::Bank)) {
-        assert(prev[int(T::Command::ACT)].size() == 1);
-        unsigned long restoration = clk - prev[int(T::Command::ACT)][0];
+        assert(prev_len[int(T::Command::ACT)] == 1);
+        unsigned long restoration = clk - prev(T::Command::ACT, 0);
         unsigned long recovery = 0;
        
-        if(prev[int(T::Command::WR)].size() == 1)
-            recovery = clk - prev[int(T::Command::WR)][0];
+        if(prev_len[int(T::Command::WR)] == 1)
+            recovery = clk - prev(T::Command::WR, 0);
 
         unsigned long rtp = 0;
 
-        if(prev[int(T::Command::RD)].size() == 1)
-            rtp = clk - prev[int(T::Command::RD)][0];
+        if(prev_len[int(T::Command::RD)] == 1)
+            rtp = clk - prev(T::Command::RD, 0);
 
         auto s = spec->speed_entry;
 
@@ -599,16 +705,14 @@ void DRAM<T>::update_timing(typename T::Command cmd, const int* addr, long clk)
     }
 
     // I am a target node
-    if (prev[int(cmd)].size()) {
-        prev[int(cmd)].pop_back();  // FIXME TIANSHI why pop back?
-        prev[int(cmd)].push_front(clk); // update history
-    }
+    if (prev_len[int(cmd)])
+        push_prev(cmd, clk); // update history (drops the oldest entry)
 
     for (auto& t : timing[int(cmd)]) {
         if (t.sibling)
             continue; // not an applicable timing parameter
 
-        long past = prev[int(cmd)][t.dist-1];
+        long past = prev(cmd, t.dist-1);
         if (past < 0)
             continue; // not enough history
 
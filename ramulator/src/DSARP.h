@@ -157,12 +157,12 @@ public:
     };
 
     /* Prerequisite */
-    function<Command(DRAM<DSARP>*, Command cmd, int)> prereq[int(Level::MAX)][int(Command::MAX)];
+    Command (*prereq[int(Level::MAX)][int(Command::MAX)])(DRAM<DSARP>*, Command cmd, int) = {};
 
     // SAUGATA: added function object container for row hit status
     /* Row hit */
-    function<bool(DRAM<DSARP>*, Command cmd, int)> rowhit[int(Level::MAX)][int(Command::MAX)];
-    function<bool(DRAM<DSARP>*, Command cmd, int)> rowopen[int(Level::MAX)][int(Command::MAX)];
+    bool (*rowhit[int(Level::MAX)][int(Command::MAX)])(DRAM<DSARP>*, Command cmd, int) = {};
+    bool (*rowopen[int(Level::MAX)][int(Command::MAX)])(DRAM<DSARP>*, Command cmd, int) = {};
 
     /* Timing */
     struct TimingEntry
@@ -175,7 +175,7 @@ public:
     vector<TimingEntry> timing[int(Level::MAX)][int(Command::MAX)];
 
     /* Lambda */
-    function<void(DRAM<DSARP>*, int)> lambda[int(Level::MAX)][int(Command::MAX)];
+    void (*lambda[int(Level::MAX)][int(Command::MAX)])(DRAM<DSARP>*, int) = {};
 
     /* Organization */
     enum class Org : int
@@ -112,12 +112,12 @@ public:
     };
 
     /* Prerequisite */
-    function<Command(DRAM<GDDR5>*, Command cmd, int)> prereq[int(Level::MAX)][int(Command::MAX)];
+    Command (*prereq[int(Level::MAX)][int(Command::MAX)])(DRAM<GDDR5>*, Command cmd, int) = {};
 
     // SAUGATA: added function object container for row hit status
     /* Row hit */
-    function<bool(DRAM<GDDR5>*, Command cmd, int)> rowhit[int(Level::MAX)][int(Command::MAX)];
-    function<bool(DRAM<GDDR5>*, Command cmd, int)> rowopen[int(Level::MAX)][int(Command::MAX)];
+    bool (*rowhit[int(Level::MAX)][int(Command::MAX)])(DRAM<GDDR5>*, Command cmd, int) = {};
+    bool (*rowopen[int(Level::MAX)][int(Command::MAX)])(DRAM<GDDR5>*, Command cmd, int) = {};
 
     /* Timing */
     struct TimingEntry
@@ -130,7 +130,7 @@ public:
     vector<TimingEntry> timing[int(Level::MAX)][int(Command::MAX)];
 
     /* Lambda */
-    function<void(DRAM<GDDR5>*, int)> lambda[int(Level::MAX)][int(Command::MAX)];
+    void (*lambda[int(Level::MAX)][int(Command::MAX)])(DRAM<GDDR5>*, int) = {};
 
     /* Organization */
     enum class Org : int
@@ -1,10 +1,12 @@
 #include "Processor.h"
+#include "Checkpoint.h"
 #include "Config.h"
 #include "Controller.h"
 #include "SpeedyController.h"
 #include "Memory.h"
 #include "DRAM.h"
 #include "Statistics.h"
+#include "ThreadPool.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -12,6 +14,10 @@
 #include <functional>
 #include <map>
 #include <chrono>
+#include <cmath>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
 
 /* Standards */
 #include "Gem5Wrapper.h"
@@ -36,11 +42,25 @@ bool ramulator::warmup_complete = false;
 ScalarStat* warmup_time;
 ScalarStat* simulation_time;
 
+// The drain before a checkpoint or a sweep takes far fewer cycles than this
+// unless a request can never complete
+const long MAX_DRAIN_CYCLES = 100000000;
+
+/* Starts writing the change of each statistic every stats_epoch_cycles
+ * cycles to <stats>.epochs, if requested. The simulation loops call
+ * Stats::statlist.check_epoch() after advancing Stats::curTick. */
+void start_stats_epochs(const Config& configs)
+{
+    long cycles = configs.get_long("stats_epoch_cycles");
+    if (cycles > 0)
+        Stats::statlist.start_epochs(configs["stats"] + ".epochs", cycles);
+}
+
 template<typename T>
 void run_dramtrace(const Config& configs, Memory<T, Controller>& memory, const char* tracename) {
 
     /* initialize DRAM trace */
-    Trace trace(tracename);
+    Trace trace(tracename, configs.get_bool("trace_reader_thread"));
 
     /* run simulation */
     bool stall = false, end = false;
@@ -52,6 +72,10 @@ void run_dramtrace(const Config& configs, Memory<T, Controller>& memory, const c
 
     Request req(addr, type, read_complete);
 
+    bool skip_idle_cycles = configs.get_bool("skip_idle_cycles");
+
+    start_stats_epochs(configs);
+
     while (!end || memory.pending_requests()){
         if (!end && !stall){
             end = !trace.get_dramtrace_request(addr, type);
@@ -66,16 +90,362 @@ void run_dramtrace(const Config& configs, Memory<T, Controller>& memory, const c
                 else if (type == Request::Type::WRITE) writes++;
             }
         }
+
+        // A stalled send keeps failing until the controller issues a
+        // command, so the idle cycles in between can be skipped
+        if (skip_idle_cycles && (end || stall)) {
+            long idle = memory.get_idle_cycles();
+            // stop short of the next epoch boundary (see skip_idle_rounds)
+            Stats::Tick to_epoch = Stats::statlist.ticks_to_epoch();
+            if (idle > 0 && Stats::Tick(idle) >= to_epoch)
+                idle = to_epoch - 1;
+            if (idle > 0) {
+                memory.skip(idle);
+                clks += idle;
+                Stats::curTick += idle;
+                continue;
+            }
+        }
+
         memory.tick();
         clks ++;
         Stats::curTick++; // memory clock, global, for Statistics
+        Stats::statlist.check_epoch();
     }
     // This a workaround for statistics set only initially lost in the end
     memory.finish();
+    Stats::statlist.finish_epochs();
     Stats::statlist.printall();
 
 }
 
+/* Skips the whole rounds of cpu_tick processor and mem_tick memory cycles
+ * in which neither the cores nor the controllers can make progress (see
+ * skip_idle_cycles in Config.h), and advances the statistics clock with
+ * them, up to the next statistics epoch. Returns the number of processor
+ * cycles skipped. */
+template <typename T>
+long skip_idle_rounds(Processor& proc, Memory<T, Controller>& memory, int cpu_tick, int mem_tick)
+{
+    long rounds = proc.get_idle_cycles() / cpu_tick;
+    if (rounds > 0)
+        rounds = min(rounds, memory.get_idle_cycles() / mem_tick);
+    // stop short of the next epoch boundary, so that the tick reaching it
+    // writes the epoch as without skipping
+    Stats::Tick to_epoch = Stats::statlist.ticks_to_epoch();
+    if (rounds > 0 && Stats::Tick(rounds * cpu_tick) >= to_epoch)
+        rounds = (to_epoch - 1) / cpu_tick;
+    if (rounds <= 0)
+        return 0;
+    proc.skip(rounds * cpu_tick);
+    memory.skip(rounds * mem_tick);
+    Stats::curTick += rounds * cpu_tick;
+    return rounds * cpu_tick;
+}
+
+/* Sampled simulation (SMARTS, Wunderlich et al., ISCA 2003): every
+ * sampling_period_insts instructions per core, a unit of
+ * sampling_unit_insts instructions is measured in detail, after
+ * sampling_warmup_insts detailed instructions that bring the in-flight
+ * state (windows, MSHRs, queues, row buffers) back to steady state. The
+ * instructions in between are fast-forwarded functionally, which keeps the
+ * caches, the open rows and the CROW tables warm. The IPC and the CROW table
+ * hit rate (the units' hits over their accesses, so that busy units weigh
+ * more) are estimated from the units, with 95% confidence intervals. The
+ * other statistics cover all the detailed instructions. */
+template <typename T>
+void run_sampled(const Config& configs, Processor& proc, Memory<T, Controller>& memory,
+        int cpu_tick, int mem_tick, bool skip_idle_cycles)
+{
+    long period = configs.get_long("sampling_period_insts");
+    long warmup = configs.get_long("sampling_warmup_insts");
+    long unit = configs.get_long("sampling_unit_insts");
+    assert(unit > 0 && period >= warmup + unit && "The sampling period should cover the warmup and the unit!");
+
+    long expected_limit_insts = configs.get_long("expected_limit_insts");
+    int tick_mult = cpu_tick * mem_tick;
+    long i = 0;
+
+    // Runs the detailed simulation until each core has issued insts more
+    // instructions or finished its trace
+    auto run_detailed = [&](long insts) {
+        vector<long> targets;
+        for (auto& core : proc.cores)
+            targets.push_back(core->get_insts() + insts);
+
+        for (bool done = false; !done; i++) {
+            if (skip_idle_cycles && (i % tick_mult == 0))
+                i += skip_idle_rounds(proc, memory, cpu_tick, mem_tick) * mem_tick;
+
+            if (((i % tick_mult) % mem_tick) == 0) {
+                proc.tick();
+                Stats::curTick++;
+                Stats::statlist.check_epoch();
+
+                done = true;
+                for (unsigned int c = 0; c < proc.cores.size(); c++) {
+                    if (!proc.cores[c]->finished() && proc.cores[c]->get_insts() < targets[c])
+                        done = false;
+                }
+            }
+
+            if (((i % tick_mult) % cpu_tick) == 0)
+                memory.tick();
+        }
+    };
+
+    auto all_done = [&]() {
+        for (auto& core : proc.cores) {
+            if (expected_limit_insts != 0) {
+                if (core->get_insts() + core->fast_forwarded < expected_limit_insts)
+                    return false;
+            } else if (!core->finished()) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto crow_accesses = [&memory](long& hits, long& misses) {
+        hits = misses = 0;
+        for (auto ctrl : memory.ctrls) {
+            hits += ctrl->get_crow_hits();
+            misses += ctrl->get_crow_misses();
+        }
+    };
+
+    vector<double> ipcs, unit_hits, unit_accesses;
+    vector<long> retired(proc.cores.size()), clks(proc.cores.size());
+    while (!all_done()) {
+        proc.fast_forward(period - warmup - unit);
+        if (all_done())
+            break;
+
+        run_detailed(warmup);
+
+        for (unsigned int c = 0; c < proc.cores.size(); c++) {
+            retired[c] = proc.cores[c]->retired;
+            clks[c] = proc.cores[c]->clk;
+        }
+        long hits, misses;
+        crow_accesses(hits, misses);
+
+        run_detailed(unit);
+
+        double ipc = 0;
+        for (unsigned int c = 0; c < proc.cores.size(); c++) {
+            long cycles = proc.cores[c]->clk - clks[c];
+            if (cycles > 0)
+                ipc += double(proc.cores[c]->retired - retired[c]) / cycles;
+        }
+        ipcs.push_back(ipc);
+
+        long end_hits, end_misses;
+        crow_accesses(end_hits, end_misses);
+        unit_hits.push_back(end_hits - hits);
+        unit_accesses.push_back(end_hits - hits + end_misses - misses);
+    }
+
+    // mean and half-width of the 95% confidence interval
+    auto estimate = [](const vector<double>& samples, double& mean, double& ci) {
+        mean = ci = 0;
+        if (samples.empty())
+            return;
+        for (double s : samples)
+            mean += s;
+        mean /= samples.size();
+        if (samples.size() < 2)
+            return;
+        double var = 0;
+        for (double s : samples)
+            var += (s - mean) * (s - mean);
+        var /= samples.size() - 1;
+        ci = 1.96 * sqrt(var / samples.size());
+    };
+
+    // Ratio estimator of sum(ys) / sum(xs), which weighs each unit by its
+    // xs, and the half-width of its 95% confidence interval
+    auto estimate_ratio = [](const vector<double>& ys, const vector<double>& xs,
+            double& ratio, double& ci) {
+        ratio = ci = 0;
+        double sum_y = 0, sum_x = 0;
+        for (unsigned int i = 0; i < xs.size(); i++) {
+            sum_y += ys[i];
+            sum_x += xs[i];
+        }
+        if (sum_x == 0)
+            return;
+        ratio = sum_y / sum_x;
+        if (xs.size() < 2)
+            return;
+        double var = 0;
+        for (unsigned int i = 0; i < xs.size(); i++)
+            var += (ys[i] - ratio * xs[i]) * (ys[i] - ratio * xs[i]);
+        var /= xs.size() - 1;
+        double mean_x = sum_x / xs.size();
+        ci = 1.96 * sqrt(var / xs.size()) / mean_x;
+    };
+
+    ScalarStat* sampling_units = new ScalarStat();
+    ScalarStat* sampled_ipc = new ScalarStat();
+    ScalarStat* sampled_ipc_ci95 = new ScalarStat();
+    ScalarStat* sampled_crow_hit_rate = new ScalarStat();
+    ScalarStat* sampled_crow_hit_rate_ci95 = new ScalarStat();
+    ScalarStat* fast_forwarded_insts = new ScalarStat();
+    sampling_units
+            ->name("sampling_units")
+            .desc("Number of measured units of the sampled simulation.")
+            .precision(0)
+            ;
+    sampled_ipc
+            ->name("sampled_ipc")
+            .desc("Mean over the measured units of the sum of the cores' IPC.")
+            .precision(6)
+            ;
+    sampled_ipc_ci95
+            ->name("sampled_ipc_ci95")
+            .desc("Half-width of the 95% confidence interval of sampled_ipc.")
+            .precision(6)
+            ;
+    sampled_crow_hit_rate
+            ->name("sampled_crow_hit_rate")
+            .desc("CROW table hits over accesses in the measured units.")
+            .precision(6)
+            ;
+    sampled_crow_hit_rate_ci95
+            ->name("sampled_crow_hit_rate_ci95")
+            .desc("Half-width of the 95% confidence interval of sampled_crow_hit_rate.")
+            .precision(6)
+            ;
+    fast_forwarded_insts
+            ->name("fast_forwarded_insts")
+            .desc("Number of instructions executed functionally, over all cores.")
+            .precision(0)
+            ;
+
+    double mean, ci;
+    *sampling_units = ipcs.size();
+    estimate(ipcs, mean, ci);
+    *sampled_ipc = mean;
+    *sampled_ipc_ci95 = ci;
+    estimate_ratio(unit_hits, unit_accesses, mean, ci);
+    *sampled_crow_hit_rate = mean;
+    *sampled_crow_hit_rate_ci95 = ci;
+    long ff = 0;
+    for (auto& core : proc.cores)
+        ff += core->fast_forwarded;
+    *fast_forwarded_insts = ff;
+}
+
+/* Saves or loads the state at the end of the warmup (see Checkpoint), so
+ * that simulations that only differ in their sim_options (-c) can share a
+ * warmup. Both the saving and the loading simulation continue from the
+ * drained state with the same random seed. */
+template <typename T>
+void checkpoint(const string& fname, bool saving, Processor& proc, Memory<T, Controller>& memory)
+{
+    printf("%s the checkpoint %s...\n", saving ? "Saving" : "Loading", fname.c_str());
+    Checkpoint cp(fname, saving);
+    cp.io(Stats::curTick);
+    proc.checkpoint(cp);
+    memory.checkpoint(cp);
+    srand(0);
+}
+
+/* Simulates the sweep points, one per line of the sweep file, after the
+ * warmup they share. A line gives the sim_options (-c) of a point, e.g.,
+ * "copy_rows_per_SA=8 crow_replacement=SRRIP"; empty lines and lines
+ * starting with # are skipped. The drained simulator forks a process per
+ * point, at most sweep_jobs at a time, which resumes from the same state
+ * and random seed as a checkpoint_load would, applies the point's options
+ * and writes its statistics to <stats>.<point>. Returns only in the forked
+ * processes. */
+template <typename T>
+void run_sweep(Config& configs, Processor& proc, Memory<T, Controller>& memory)
+{
+    string sweep = configs["sweep"];
+    ifstream file(sweep);
+    if (!file.good()) {
+        cerr << "Error: cannot open the sweep file " << sweep << endl;
+        exit(-1);
+    }
+    vector<vector<pair<string, string>>> points;
+    vector<string> point_lines;
+    string line;
+    while (getline(file, line)) {
+        stringstream ss(line);
+        string option;
+        vector<pair<string, string>> point;
+        while (ss >> option) {
+            if (option[0] == '#')
+                break;
+            size_t eq = option.find('=');
+            if (eq == string::npos || eq == 0) {
+                cerr << "Error: invalid option " << option << " in the sweep file " << sweep << endl;
+                exit(-1);
+            }
+            point.push_back(make_pair(option.substr(0, eq), option.substr(eq + 1)));
+        }
+        if (point.empty())
+            continue;
+        points.push_back(point);
+        point_lines.push_back(line);
+    }
+
+    int jobs = configs.get_int("sweep_jobs");
+    if (jobs <= 0)
+        jobs = ThreadPool::available_cpus();
+
+    // the threads would not survive the fork
+    proc.suspend();
+    memory.stop_threads();
+    fflush(stdout);
+    cout.flush();
+
+    string stats = configs["stats"];
+    map<pid_t, int> running;
+    int failed = 0;
+    auto wait_point = [&running, &failed]() {
+        int status;
+        pid_t pid = wait(&status);
+        assert(running.count(pid));
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            cerr << "Error: sweep point " << running[pid] << " failed." << endl;
+            failed++;
+        }
+        running.erase(pid);
+    };
+
+    for (int p = 0; p < int(points.size()); p++) {
+        if (int(running.size()) == jobs)
+            wait_point();
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "Error: cannot fork the sweep point " << p << endl;
+            exit(-1);
+        }
+        if (pid == 0) {
+            for (auto& option : points[p])
+                configs.set_sim_option(option.first, option.second);
+            configs.set("stats", stats + "." + to_string(p));
+            Stats::statlist.output(configs["stats"]);
+            proc.resume();
+            srand(0);
+            return;
+        }
+        printf("Sweep point %d: %s\n", p, point_lines[p].c_str());
+        fflush(stdout);
+        running[pid] = p;
+    }
+    while (!running.empty())
+        wait_point();
+
+    printf("Sweep done, %d of %d points failed. Statistics written to %s.<point>\n",
+            failed, int(points.size()), stats.c_str());
+    exit(failed ? -1 : 0);
+}
+
 template <typename T>
 void run_cputrace(Config& configs, Memory<T, Controller>& memory, const std::vector<std::string>& files)
 {
@@ -88,9 +458,22 @@ void run_cputrace(Config& configs, Memory<T, Controller>& memory, const std::vec
     long warmup_insts = configs.get_long("warmup_insts");
     bool is_warming_up = (warmup_insts != 0);
 
+    string checkpoint_save = configs["checkpoint_save"];
+    string checkpoint_load = configs["checkpoint_load"];
+    assert((checkpoint_save == "" || checkpoint_load == "") &&
+            "A simulation can either save or load a checkpoint.");
+    string sweep = configs["sweep"];
+    if (checkpoint_load != "")
+        is_warming_up = false;
+
+    bool skip_idle_cycles = configs.get_bool("skip_idle_cycles");
+
     auto start = std::chrono::steady_clock::now();
 
     for(long i = 0; is_warming_up; i++){
+        if (skip_idle_cycles && (i % cpu_tick == 0))
+            i += skip_idle_rounds(proc, memory, cpu_tick, mem_tick);
+
         proc.tick();
         Stats::curTick++;
         if (i % cpu_tick == (cpu_tick - 1))
@@ -104,6 +487,35 @@ void run_cputrace(Config& configs, Memory<T, Controller>& memory, const std::vec
         }
 
     }
+
+    if (checkpoint_save != "" || (sweep != "" && checkpoint_load == "")) {
+        // let the requests in flight complete
+        proc.drain(true);
+        memory.drain(true);
+        for (long i = 0; !proc.is_drained() || !memory.is_drained(); i++) {
+            if (i == MAX_DRAIN_CYCLES) {
+                cerr << "Error: the requests in flight did not complete within "
+                     << MAX_DRAIN_CYCLES << " cycles after the warmup." << endl;
+                exit(-1);
+            }
+            proc.tick();
+            Stats::curTick++;
+            if (i % cpu_tick == (cpu_tick - 1))
+                for (int j = 0; j < mem_tick; j++)
+                    memory.tick();
+        }
+        proc.drain(false);
+        memory.drain(false);
+    }
+    if (checkpoint_save != "") {
+        checkpoint(checkpoint_save, true, proc, memory);
+    } else if (checkpoint_load != "") {
+        checkpoint(checkpoint_load, false, proc, memory);
+    }
+
+    if (sweep != "")
+        run_sweep(configs, proc, memory);
+
     auto warmup_duration = std::chrono::duration_cast<std::chrono::seconds> 
                                     (std::chrono::steady_clock::now() - start);
 
@@ -119,37 +531,48 @@ void run_cputrace(Config& configs, Memory<T, Controller>& memory, const std::vec
     mem_tick = configs.get_int("mem_tick"); // reload option in case it is different in sim_options.
     memory.reload_options(configs); // FIXME
 
+    start_stats_epochs(configs);
     start = std::chrono::steady_clock::now();
 
     bool is_early_exit = configs.get_bool("early_exit");
     int tick_mult = cpu_tick * mem_tick;
-    for (long i = 0; ; i++) {
-        if (((i % tick_mult) % mem_tick) == 0) { // We use mem_tick to check when to tick the CPU. 
-                                                 // It is due to the definition of the tick ratios.
-                                                 // e.g., When the CPU is ticked cpu_tick times,
-                                                 // the memory controller should be ticked mem_tick times
-            proc.tick();
-            Stats::curTick++; // processor clock, global, for Statistics
-
-            if (configs.calc_weighted_speedup()) {
-                if (proc.has_reached_limit()) {
-                    break;
-                }
-            } else {
-                if (is_early_exit) {
-                    if (proc.finished())
-                    break;
+    if (configs.get_bool("sampling")) {
+        run_sampled(configs, proc, memory, cpu_tick, mem_tick, skip_idle_cycles);
+    } else {
+        for (long i = 0; ; i++) {
+            // a processor cycle is mem_tick iterations
+            if (skip_idle_cycles && (i % tick_mult == 0))
+                i += skip_idle_rounds(proc, memory, cpu_tick, mem_tick) * mem_tick;
+
+            if (((i % tick_mult) % mem_tick) == 0) { // We use mem_tick to check when to tick the CPU. 
+                                                     // It is due to the definition of the tick ratios.
+                                                     // e.g., When the CPU is ticked cpu_tick times,
+                                                     // the memory controller should be ticked mem_tick times
+                proc.tick();
+                Stats::curTick++; // processor clock, global, for Statistics
+                Stats::statlist.check_epoch();
+
+                if (configs.calc_weighted_speedup()) {
+                    if (proc.has_reached_limit()) {
+                        break;
+                    }
                 } else {
-                if (proc.finished() && (memory.pending_requests() == 0))
-                    break;
+                    if (is_early_exit) {
+                        if (proc.finished())
+                        break;
+                    } else {
+                    if (proc.finished() && (memory.pending_requests() == 0))
+                        break;
+                    }
                 }
             }
-        }
         
-        if (((i % tick_mult) % cpu_tick) == 0)
-            memory.tick();
+            if (((i % tick_mult) % cpu_tick) == 0)
+                memory.tick();
 
+        }
     }
+
     // This a workaround for statistics set only initially lost in the end
     memory.finish();
 
@@ -159,6 +582,7 @@ void run_cputrace(Config& configs, Memory<T, Controller>& memory, const std::vec
     (*warmup_time) += warmup_duration.count();
     (*simulation_time) += simulation_duration.count();
 
+    Stats::statlist.finish_epochs();
     Stats::statlist.printall();
 }
 
@@ -206,11 +630,23 @@ int main(int argc, char* argv[])
     assert(mode != "" || "The trace type (\'mode\') should be specified.");
 
     string stats_out = configs["stats"];
-    if (stats_out != "") {
-      Stats::statlist.output(stats_out);
-    } else {
-      Stats::statlist.output(standard+".stats");
+    if (stats_out == "") {
       stats_out = standard + string(".stats");
+      configs.set("stats", stats_out);
+    }
+    // the points of a sweep write their own statistics (see run_sweep)
+    if (configs["sweep"] == "") {
+      Stats::statlist.output(stats_out);
+    }
+
+    const std::string& stats_format = configs.get_str("stats_format");
+    if (stats_format == "json") {
+      Stats::statlist.format(Stats::Format::JSON);
+    } else if (stats_format == "csv") {
+      Stats::statlist.format(Stats::Format::CSV);
+    } else if (stats_format != "text") {
+      cerr << "Error: unknown stats_format " << stats_format << endl;
+      exit(-1);
     }
    
     warmup_time = new ScalarStat();
@@ -282,7 +718,7 @@ int main(int argc, char* argv[])
     //  start_run(configs, tldram, files);
     }
 
-    printf("Simulation done. Statistics written to %s\n", stats_out.c_str());
+    printf("Simulation done. Statistics written to %s\n", configs["stats"].c_str());
 
     return 0;
 }
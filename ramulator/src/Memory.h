@@ -7,6 +7,7 @@
 #include "Controller.h"
 #include "SpeedyController.h"
 #include "Statistics.h"
+#include "ThreadPool.h"
 #include "GDDR5.h"
 #include "HBM.h"
 //#include "LPDDR3.h"
@@ -17,6 +18,7 @@
 #include <functional>
 #include <cmath>
 #include <cassert>
+#include <limits>
 #include <tuple>
 
 using namespace std;
@@ -31,11 +33,20 @@ public:
     virtual double clk_ns() = 0;
     virtual void tick() = 0;
     virtual bool send(Request req) = 0;
+    virtual void warm(Request req) = 0;
     virtual bool upgrade_prefetch_req(long addr) = 0;
     virtual int pending_requests() = 0;
     virtual void finish(void) = 0;
     virtual long page_allocator(long addr, int coreid) = 0;
+    // Translates addr like page_allocator() if its page is assigned
+    // already, and returns false otherwise. It assigns nothing, so the
+    // cores may look up their pages concurrently.
+    virtual bool find_page(long& addr, int coreid) = 0;
     virtual void record_core(int coreid) = 0;
+    // Whether no request is in flight, and saving or loading the state of
+    // a memory that is (see Checkpoint)
+    virtual bool is_drained() = 0;
+    virtual void checkpoint(Checkpoint& cp) = 0;
 };
 
 template <class T, template<typename> class Controller = Controller >
@@ -90,6 +101,8 @@ public:
 
     vector<Controller<T>*> ctrls;
     T * spec;
+    ThreadPool* thread_pool = nullptr;
+    function<void(int)> tick_channel;
     vector<int> addr_bits;
 
     int tx_bits;
@@ -134,6 +147,20 @@ public:
           free_physical_pages.resize(free_physical_pages_remaining, -1);
         }
 
+        // Tick the channels concurrently if requested and possible
+        // (the workers spin between cycles, so never oversubscribe the host)
+        int threads = min(configs.get_int("memory_threads"), int(ctrls.size()));
+        threads = min(threads, ThreadPool::available_cpus());
+        for (auto ctrl : ctrls)
+            if (!ctrl->supports_parallel_tick())
+                threads = 1;
+        if (threads > 1) {
+            thread_pool = new ThreadPool(threads);
+            tick_channel = [this](int i) { this->ctrls[i]->tick(); };
+            for (auto ctrl : ctrls)
+                ctrl->set_parallel_tick(true);
+        }
+
         dram_capacity
             .name("dram_capacity")
             .desc("Number of bytes in simulated DRAM")
@@ -237,6 +264,7 @@ public:
 
     ~Memory()
     {
+        delete thread_pool;
         for (auto ctrl: ctrls)
             delete ctrl;
         delete spec;
@@ -269,6 +297,43 @@ public:
         return spec->speed_entry.tCK;
     }
 
+    bool is_drained() {
+        for (auto ctrl : ctrls) {
+            if (!ctrl->is_drained())
+                return false;
+        }
+        return true;
+    }
+
+    void checkpoint(Checkpoint& cp) {
+        cp.check(ctrls.size(), "number of channels");
+        for (auto ctrl : ctrls)
+            ctrl->checkpoint(cp);
+
+        cp.io(free_physical_pages);
+        cp.io(free_physical_pages_remaining);
+        cp.io(page_translation);
+    }
+
+    // With drain, the controllers also serve the writes that would wait
+    // for the write queue to fill up, so that no request stays in flight
+    // (see is_drained)
+    void drain(bool drain) {
+        for (auto ctrl : ctrls)
+            ctrl->draining = drain;
+    }
+
+    // Tick the channels on the calling thread from now on, e.g., before a
+    // fork, which the workers would not survive (see run_sweep)
+    void stop_threads() {
+        if (thread_pool == nullptr)
+            return;
+        delete thread_pool;
+        thread_pool = nullptr;
+        for (auto ctrl : ctrls)
+            ctrl->set_parallel_tick(false);
+    }
+
     void record_core(int coreid) {
 #ifndef INTEGRATED_WITH_GEM5
       record_read_requests[coreid] = num_read_requests[coreid];
@@ -294,13 +359,61 @@ public:
         in_queue_read_req_num_sum += cur_que_readreq_num;
         in_queue_write_req_num_sum += cur_que_writereq_num;
 
+        bool is_active = false;
+        if (thread_pool == nullptr) {
+            for (auto ctrl : ctrls) {
+              is_active = is_active || ctrl->is_active();
+              ctrl->tick();
+            }
+        } else {
+            // A controller's tick() never changes another channel, so the
+            // activity of all channels can be sampled up front. Callbacks
+            // into the caches are delivered afterwards, in channel order.
+            for (auto ctrl : ctrls)
+              is_active = is_active || ctrl->is_active();
+            thread_pool->run(ctrls.size(), tick_channel);
+            for (auto ctrl : ctrls)
+              ctrl->finish_parallel_tick();
+        }
+        if (is_active) {
+          ramulator_active_cycles++;
+        }
+    }
+
+    // The number of upcoming tick() calls during which no controller serves a
+    // request, refreshes or issues a command (see Controller::get_next_event)
+    long get_idle_cycles()
+    {
+        long idle = numeric_limits<long>::max();
+        for (auto ctrl : ctrls) {
+            idle = min(idle, ctrl->get_next_event() - ctrl->clk - 1);
+            if (!idle)
+                break;
+        }
+        return idle;
+    }
+
+    // Fast-forward over idle cycles, producing the same statistics as
+    // calling tick() that many times
+    void skip(long cycles)
+    {
+        num_dram_cycles += cycles;
+        int cur_que_req_num = 0;
+        int cur_que_readreq_num = 0;
+        int cur_que_writereq_num = 0;
         bool is_active = false;
         for (auto ctrl : ctrls) {
+          cur_que_req_num += ctrl->readq.size() + ctrl->writeq.size() + ctrl->pending.size();
+          cur_que_readreq_num += ctrl->readq.size() + ctrl->pending.size();
+          cur_que_writereq_num += ctrl->writeq.size();
           is_active = is_active || ctrl->is_active();
-          ctrl->tick();
+          ctrl->skip(cycles);
         }
+        in_queue_req_num_sum += cycles * cur_que_req_num;
+        in_queue_read_req_num_sum += cycles * cur_que_readreq_num;
+        in_queue_write_req_num_sum += cycles * cur_que_writereq_num;
         if (is_active) {
-          ramulator_active_cycles++;
+          ramulator_active_cycles += cycles;
         }
     }
 
@@ -347,6 +460,13 @@ public:
         return false;
     }
 
+    // Functional counterpart of send() (see Controller::warm)
+    void warm(Request req)
+    {
+        update_addr_vec(req);
+        ctrls[req.addr_vec[0]]->warm(req);
+    }
+
     bool upgrade_prefetch_req(long addr) {
         Request tmp_req;
         tmp_req.addr = addr;
@@ -458,6 +578,17 @@ public:
 
     }
 
+    bool find_page(long& addr, int coreid) {
+        if (translation == Translation::None)
+            return true;
+
+        auto it = page_translation.find(make_pair(coreid, addr >> 12));
+        if (it == page_translation.end())
+            return false;
+        addr = (it->second << 12) | (addr & ((1 << 12) - 1));
+        return true;
+    }
+
     void reload_options(const Config& configs) {
         spec->set_subarray_number(configs.get_int("subarrays"));
         set_DRAM_sizes(configs);
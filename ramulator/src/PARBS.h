@@ -21,7 +21,7 @@ class PARBS : public SchedulerBase<T>{
 public:
     Controller<T>* ctrl;
 
-    typedef list<Request>::iterator ReqIter;
+    typedef RequestQueue::iterator ReqIter;
     PARBS(Controller<T>* ctrl) : ctrl(ctrl) {
         numberCores = 1;
         _markedLoad = 0;
@@ -38,6 +38,7 @@ public:
 
     void form_batch();
     void assign_rank();
+    void checkpoint(Checkpoint& cp);
 private:
     int batch_cap = 5;
     int prio_max = 11;
@@ -159,7 +160,7 @@ void PARBS<T>::form_batch(){
     }
 
     unsigned bcount = 0;
-    for (list<Request>::iterator it=ctrl->readq.q.begin(); it != ctrl->readq.q.end(); ++it){
+    for (ReqIter it=ctrl->readq.q.begin(); it != ctrl->readq.q.end(); ++it){
         if(!(it->marked)){
             int p = it->coreid;
             if((p < numberCores) && (bcount < LocalBcount))
@@ -253,5 +254,14 @@ bool PARBS<T>::sort_maxtot(int tid1, int tid2){
     return false;
 }
 
+// The markable queues are only filled and read within form_batch()
+template <typename T>
+void PARBS<T>::checkpoint(Checkpoint& cp){
+    cp.io(_rank);
+    cp.io(_markedLoad);
+    cp.io(_markedMaxLoadPerProc);
+    cp.io(_markedTotalLoadPerProc);
+}
+
 }/*namespace ramulator*/
 #endif // PARBS_H
@@ -1,10 +1,17 @@
 #include "Processor.h"
 #include "StridePrefetcher.h"
 #include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace ramulator;
 
+const long Processor::FAST_FORWARD_BATCH;
+
 Processor::Processor(const Config& configs,
     vector<std::string> trace_list,
     function<bool(Request)> send_memory,
@@ -21,6 +28,7 @@ Processor::Processor(const Config& configs,
          Cache::Level::L3, cachesys) {
 
   assert(cachesys != nullptr);
+  cachesys->warm_memory = [&memory](Request req) { memory.warm(req); };
   int tracenum = trace_list.size();
   assert(tracenum > 0);
   printf("tracenum: %d\n", tracenum);
@@ -76,6 +84,21 @@ Processor::Processor(const Config& configs,
             .precision(0)
             ;
   cpu_cycles = 0;
+
+  // Advance the cores concurrently if requested and possible
+  int threads = min(configs.get_int("processor_threads"), tracenum);
+  threads = min(threads, ThreadPool::available_cpus());
+  if (threads > 1) {
+    thread_pool = new ThreadPool(threads);
+    tick_core_private = [this](int i) { cores[i]->tick_private(); };
+    for (auto& core : cores) {
+      core->send_privately = !core->no_core_caches;
+    }
+  }
+}
+
+Processor::~Processor() {
+  delete thread_pool;
 }
 
 void Processor::tick() {
@@ -87,10 +110,71 @@ void Processor::tick() {
   if (!(no_core_caches && no_shared_cache)) {
     cachesys->tick();
   }
+  if (thread_pool == nullptr) {
+    for (unsigned int i = 0 ; i < cores.size() ; ++i) {
+      Core* core = cores[i].get();
+      core->tick();
+    }
+  } else {
+    // The private part of a core's tick does not depend on what the cores
+    // before it sent this cycle, so only the sends to the shared caches and
+    // the memory are kept in core order. The private caches see the lines
+    // that the LLC misses of the other cores invalidate in the next cycle.
+    thread_pool->run(cores.size(), tick_core_private);
+    for (unsigned int i = 0 ; i < cores.size() ; ++i) {
+      Core* core = cores[i].get();
+      core->tick_shared();
+    }
+  }
+}
+
+long Processor::get_idle_cycles() {
   for (unsigned int i = 0 ; i < cores.size() ; ++i) {
-    Core* core = cores[i].get();
-    core->tick();
+    if (!cores[i]->is_idle()) {
+      return 0;
+    }
+  }
+
+  // stop right before the next heartbeat so that it is still printed
+  long cycles = long(cpu_cycles.value());
+  long idle = (cycles / 50000000 + 1) * 50000000 - cycles - 1;
+
+  if (!(no_core_caches && no_shared_cache)) {
+    idle = min(idle, cachesys->get_idle_cycles());
   }
+  return idle;
+}
+
+void Processor::skip(long cycles) {
+  cpu_cycles += cycles;
+
+  if (!(no_core_caches && no_shared_cache)) {
+    cachesys->skip(cycles);
+  }
+  for (unsigned int i = 0 ; i < cores.size() ; ++i) {
+    cores[i]->skip(cycles);
+  }
+}
+
+long Processor::fast_forward(long insts) {
+  // round-robin in small batches, so that the shared cache and the memory
+  // see the accesses of the cores interleaved
+  vector<long> left(cores.size(), insts);
+  long total = 0;
+  for (bool more = true; more; ) {
+    more = false;
+    for (unsigned int i = 0 ; i < cores.size() ; ++i) {
+      if (left[i] == 0)
+        continue;
+      long batch = min(left[i], FAST_FORWARD_BATCH);
+      long done = cores[i]->fast_forward(batch);
+      total += done;
+      // fewer only at the end of the trace
+      left[i] = (done < batch) ? 0 : left[i] - done;
+      more = more || left[i] > 0;
+    }
+  }
+  return total;
 }
 
 void Processor::receive(Request& req) {
@@ -153,6 +237,46 @@ long Processor::get_insts() {
     return insts_total;
 }
 
+void Processor::drain(bool drain) {
+    for (unsigned int i = 0 ; i < cores.size(); i++) {
+        cores[i]->drain(drain);
+    }
+}
+
+bool Processor::is_drained() {
+    for (unsigned int i = 0 ; i < cores.size(); i++) {
+        if (!cores[i]->is_drained()) {
+            return false;
+        }
+    }
+    return cachesys->is_drained();
+}
+
+void Processor::checkpoint(Checkpoint& cp) {
+    cp.check(cores.size(), "number of cores");
+    for (unsigned int i = 0 ; i < cores.size(); i++) {
+        cores[i]->checkpoint(cp);
+    }
+    if (!no_shared_cache) {
+        llc.checkpoint(cp);
+    }
+    cp.io(cachesys->clk);
+}
+
+void Processor::suspend() {
+    delete thread_pool;
+    thread_pool = nullptr;
+    for (unsigned int i = 0 ; i < cores.size(); i++) {
+        cores[i]->suspend();
+    }
+}
+
+void Processor::resume() {
+    for (unsigned int i = 0 ; i < cores.size(); i++) {
+        cores[i]->resume();
+    }
+}
+
 void Processor::reset_stats() {
     for (unsigned int i = 0 ; i < cores.size(); i++) {
         cores[i]->reset_stats();
@@ -169,7 +293,8 @@ Core::Core(const Config& configs, int coreid,
     Cache* llc, std::shared_ptr<CacheSystem> cachesys, MemoryBase& memory)
     : id(coreid), no_core_caches(!configs.has_core_caches()),
     no_shared_cache(!configs.has_l3_cache()),
-    llc(llc), trace(trace_fname), memory(memory)
+    llc(llc), trace(trace_fname, configs.get_bool("trace_reader_thread")),
+    cachesys(cachesys), memory(memory)
 {
   // Build cache hierarchy
   if (no_core_caches) {
@@ -178,11 +303,11 @@ Core::Core(const Config& configs, int coreid,
     // L2 caches[0]
     caches.emplace_back(new Cache(
         l2_size, l2_assoc, l2_blocksz, l2_mshr_num,
-        Cache::Level::L2, cachesys));
+        Cache::Level::L2, cachesys, id));
     // L1 caches[1]
     caches.emplace_back(new Cache(
         l1_size, l1_assoc, l1_blocksz, l1_mshr_num,
-        Cache::Level::L1, cachesys));
+        Cache::Level::L1, cachesys, id));
     send = bind(&Cache::send, caches[1].get(), placeholders::_1);
     if (llc != nullptr) {
       caches[0]->concatlower(llc);
@@ -233,11 +358,19 @@ double Core::calc_ipc()
 }
 
 void Core::tick()
+{
+    tick_private();
+    tick_shared();
+}
+
+void Core::tick_private()
 {
     clk++;
+    send_ready = false;
 
     retired += window.retire();
 
+    if (draining) return;
     if (expected_limit_insts == 0 && !more_reqs) return;
 
     // bubbles (non-memory operations)
@@ -253,59 +386,156 @@ void Core::tick()
         if (long(cpu_inst.value()) == expected_limit_insts && !reached_limit) {
           record_cycs = clk;
           record_insts = long(cpu_inst.value());
-          memory.record_core(id);
+          record_pending = true;
           reached_limit = true;
         }
     }
 
     if (req_type == Request::Type::READ) {
-        // read request
         if (inserted == window.ipc) return;
         if (window.is_full()) return;
+    }
+
+    send_ready = true;
+    if (send_privately) {
+        send_request();
+    } else {
+        trace.read_ahead();
+    }
+}
+
+void Core::tick_shared()
+{
+    // a limit reached among the bubbles is recorded before the send
+    record_core();
+
+    if (send_privately) {
+        shared_ops.replay(*cachesys);
+        if (page_pending) {
+            req_addr = memory.page_allocator(req_addr, id);
+            page_pending = false;
+        }
+    } else if (send_ready) {
+        send_request();
+    }
 
-        Request req(req_addr, req_type, callback, id);
-        if (!send(req)) return;
+    record_core();
+}
 
-        window.insert(false, req_addr);
-        cpu_inst++;
+void Core::send_request()
+{
+    Request req(req_addr, req_type, callback, id);
+    if (send_privately) {
+        // the private caches queue what they do to the shared state
+        for (auto& cache : caches) cache->deferred = &shared_ops;
+        bool sent = send(req);
+        for (auto& cache : caches) cache->deferred = nullptr;
+        if (!sent) return;
+    } else if (!send(req)) {
+        return;
     }
-    else {
-        // write request
+
+    if (req_type == Request::Type::READ) {
+        window.insert(false, req_addr);
+    } else {
         assert(req_type == Request::Type::WRITE);
-        Request req(req_addr, req_type, callback, id);
-        if (!send(req)) return;
-        cpu_inst++;
     }
+    cpu_inst++;
     if (long(cpu_inst.value()) == expected_limit_insts && !reached_limit) {
       record_cycs = clk;
       record_insts = long(cpu_inst.value());
-      memory.record_core(id);
+      record_pending = true;
       reached_limit = true;
     }
 
     if (no_core_caches) {
       more_reqs = trace.get_filtered_request(
           bubble_cnt, req_addr, req_type);
-      if (req_addr != -1) {
-        req_addr = memory.page_allocator(req_addr, id);
-      }
     } else {
       more_reqs = trace.get_unfiltered_request(
           bubble_cnt, req_addr, req_type);
-      if (req_addr != -1) {
+    }
+    if (req_addr != -1) {
+      if (!send_privately) {
         req_addr = memory.page_allocator(req_addr, id);
+      } else {
+        // a new page is assigned by tick_shared(), in core order
+        page_pending = !memory.find_page(req_addr, id);
       }
     }
     if (!more_reqs) {
       if (!reached_limit) { // if the length of this trace is shorter than expected length, then record it when the whole trace finishes, and set reached_limit to true.
         record_cycs = clk;
         record_insts = long(cpu_inst.value());
-        memory.record_core(id);
+        record_pending = true;
         reached_limit = true;
       }
     }
 }
 
+void Core::record_core()
+{
+    if (record_pending) {
+        memory.record_core(id);
+        record_pending = false;
+    }
+}
+
+bool Core::is_idle()
+{
+    // nothing retires until a response marks the oldest instruction ready
+    if (window.can_retire()) return false;
+
+    if (expected_limit_insts == 0 && !more_reqs) return true;
+
+    // a full window blocks both bubbles and reads, but writes are sent anyway
+    return window.is_full() &&
+        (bubble_cnt > 0 || req_type == Request::Type::READ);
+}
+
+void Core::skip(long cycles)
+{
+    clk += cycles;
+}
+
+long Core::fast_forward(long insts)
+{
+    long done = 0;
+    while (done < insts) {
+        if (expected_limit_insts == 0 && !more_reqs) break;
+
+        if (bubble_cnt > 0) {
+            long n = min(bubble_cnt, insts - done);
+            bubble_cnt -= n;
+            done += n;
+            continue;
+        }
+
+        Request req(req_addr, req_type, id);
+        if (!no_core_caches) {
+            caches[1]->warm(req);
+        } else if (llc != nullptr) {
+            llc->warm(req);
+        } else {
+            memory.warm(req);
+        }
+        done++;
+
+        if (no_core_caches) {
+          more_reqs = trace.get_filtered_request(
+              bubble_cnt, req_addr, req_type);
+        } else {
+          more_reqs = trace.get_unfiltered_request(
+              bubble_cnt, req_addr, req_type);
+        }
+        if (req_addr != -1) {
+          req_addr = memory.page_allocator(req_addr, id);
+        }
+    }
+    fast_forwarded += done;
+    return done;
+}
+
 bool Core::finished()
 {
     return !more_reqs && window.is_empty();
@@ -328,6 +558,30 @@ void Core::receive(Request& req)
     }
 }
 
+void Core::checkpoint(Checkpoint& cp) {
+    trace.checkpoint(cp);
+    window.checkpoint(cp);
+
+    cp.io(clk);
+    cp.io(retired);
+    long insts = get_insts();
+    cp.io(insts);
+    cpu_inst = insts;
+    cp.io(fast_forwarded);
+    cp.io(bubble_cnt);
+    cp.io(req_addr);
+    cp.io(req_type);
+    cp.io(more_reqs);
+    cp.io(last);
+    cp.io(reached_limit);
+    cp.io(send_ready);
+    cp.io(record_pending);
+
+    for (auto& cache : caches) {
+        cache->checkpoint(cp);
+    }
+}
+
 void Core::reset_stats() {
     clk = 0;
     retired = 0;
@@ -378,6 +632,22 @@ long Window::retire()
 }
 
 
+bool Window::can_retire()
+{
+    return load > 0 && ready_list.at(tail);
+}
+
+
+void Window::checkpoint(Checkpoint& cp)
+{
+    cp.check(depth, "window depth");
+    cp.io(load);
+    cp.io(head);
+    cp.io(tail);
+    cp.io(ready_list);
+    cp.io(addr_list);
+}
+
 void Window::set_ready(long addr, int mask)
 {
     if (load == 0) return;
@@ -392,43 +662,127 @@ void Window::set_ready(long addr, int mask)
 
 
 
-Trace::Trace(const char* trace_fname) : file(trace_fname), trace_name(trace_fname)
+bool Trace::has_write = false;
+long Trace::write_addr;
+
+static const char BINARY_TRACE_MAGIC[8] = {'R', 'A', 'M', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t BINARY_TRACE_VERSION = 1;
+static const size_t BINARY_TRACE_HEADER_SIZE = 16;
+
+Trace::Trace(const char* trace_fname, bool read_async) : file(trace_fname), trace_name(trace_fname)
 {
     if (!file.good()) {
         std::cerr << "Bad trace file: " << trace_fname << std::endl;
         exit(1);
     }
+
+    unsigned char magic[sizeof(BINARY_TRACE_MAGIC)];
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    size_t magic_size = file.gcount();
+    compression = TraceReader::detect(magic, magic_size);
+
+    if (magic_size == sizeof(magic) &&
+            memcmp(magic, BINARY_TRACE_MAGIC, sizeof(magic)) == 0) {
+        file.close();
+        if (!map_binary(trace_fname)) {
+            std::cerr << "Bad binary trace file: " << trace_fname << std::endl;
+            exit(1);
+        }
+    } else if (compression != TraceReader::Compression::None || read_async) {
+        file.close();
+        use_reader = true;
+    } else {
+        file.clear();
+        file.seekg(0, file.beg);
+    }
 }
 
-bool Trace::get_unfiltered_request(long& bubble_cnt, long& req_addr, Request::Type& req_type)
+Trace::~Trace()
 {
-    string line;
-    getline(file, line);
-    if (file.eof()) {
-      file.clear();
-      file.seekg(0, file.beg);
-      return false;
+    delete reader;
+    if (mapping != nullptr)
+        munmap(const_cast<char*>(mapping), mapping_size);
+}
+
+bool Trace::map_binary(const char* trace_fname)
+{
+    int fd = open(trace_fname, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < BINARY_TRACE_HEADER_SIZE) {
+        close(fd);
+        return false;
     }
-    size_t pos, end;
-    bubble_cnt = std::stoul(line, &pos, 10);
-    pos = line.find_first_not_of(' ', pos+1);
-    req_addr = std::stoul(line.substr(pos), &end, 0);
 
-    pos = line.find_first_not_of(' ', pos+end);
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return false;
+    madvise(m, st.st_size, MADV_SEQUENTIAL);
 
-    if (pos == string::npos || line.substr(pos)[0] == 'R')
-        req_type = Request::Type::READ;
-    else if (line.substr(pos)[0] == 'W')
-        req_type = Request::Type::WRITE;
-    else assert(false);
+    mapping = static_cast<const char*>(m);
+    mapping_size = st.st_size;
+
+    uint32_t version;
+    memcpy(&version, mapping + sizeof(BINARY_TRACE_MAGIC), sizeof(version));
+    if (version != BINARY_TRACE_VERSION)
+        return false;
+
+    records = reinterpret_cast<const BinaryTraceRecord*>(mapping + BINARY_TRACE_HEADER_SIZE);
+    num_records = (mapping_size - BINARY_TRACE_HEADER_SIZE) / sizeof(BinaryTraceRecord);
+    return true;
+}
+
+const BinaryTraceRecord* Trace::read_record(TraceReader::Format format)
+{
+    if (is_plain_text()) {
+        // text traces of format 2 are read by get_dramtrace_request
+        assert(format == TraceReader::Format::CPU);
+        read_ahead();
+        has_line_record = false;
+        if (!line_record_valid) {
+            file.clear();
+            file.seekg(0, file.beg);
+            return nullptr;
+        }
+        return &line_record;
+    }
+
+    if (use_reader) {
+        if (reader == nullptr)
+            reader = new TraceReader(trace_name, compression, format);
+        assert(reader->get_format() == format);
+        records_streamed++;
+        return reader->next(streamed_record) ? &streamed_record : nullptr;
+    }
+
+    if (next_record == num_records) {
+        if (format == TraceReader::Format::CPU)
+            next_record = 0;
+        return nullptr;
+    }
+    return &records[next_record++];
+}
+
+bool Trace::get_unfiltered_request(long& bubble_cnt, long& req_addr, Request::Type& req_type)
+{
+    const BinaryTraceRecord* rec = read_record(TraceReader::Format::CPU);
+    if (rec == nullptr)
+        return false;
+    // write-back addresses only appear in filtered traces
+    if (rec->flags & (BinaryTraceRecord::INVALID | BinaryTraceRecord::HAS_WRITEBACK))
+        bad_request_type();
+    bubble_cnt = rec->bubble_cnt;
+    req_addr = rec->addr;
+    req_type = (rec->flags & BinaryTraceRecord::WRITE) ?
+        Request::Type::WRITE : Request::Type::READ;
     return true;
 }
 
 bool Trace::get_filtered_request(long& bubble_cnt, long& req_addr, Request::Type& req_type)
 {
-    static bool has_write = false;
-    static long write_addr;
-    static int line_num = 0;
     if (has_write){
         bubble_cnt = 0;
         req_addr = write_addr;
@@ -436,36 +790,105 @@ bool Trace::get_filtered_request(long& bubble_cnt, long& req_addr, Request::Type
         has_write = false;
         return true;
     }
-    string line;
-    getline(file, line);
-    line_num ++;
-    if (file.eof() || line.size() == 0) {
-        file.clear();
-        file.seekg(0, file.beg);
-        //line_num = 0; //Hasan
-        //getline(file, line); // Hasan: starting over the file
-        //has_write = false;
-        //line_num++; //Hasan
+    const BinaryTraceRecord* rec = read_record(TraceReader::Format::CPU);
+    if (rec == nullptr)
         return false;
+    if (rec->flags & BinaryTraceRecord::INVALID)
+        bad_request_type();
+    bubble_cnt = rec->bubble_cnt;
+    req_addr = rec->addr;
+    req_type = Request::Type::READ;
+    if (rec->flags & BinaryTraceRecord::HAS_WRITEBACK) {
+        has_write = true;
+        write_addr = rec->wb_addr;
     }
+    return true;
+}
 
-    size_t pos, end;
-    bubble_cnt = std::stoul(line, &pos, 10);
+void Trace::bad_request_type()
+{
+    std::cerr << "Bad request type in trace file: " << trace_name << std::endl;
+    exit(1);
+}
 
-    pos = line.find_first_not_of(' ', pos+1);
-    req_addr = stoul(line.substr(pos), &end, 0);
-    req_type = Request::Type::READ;
+void Trace::checkpoint(Checkpoint& cp)
+{
+    // text traces
+    long pos = is_plain_text() ? long(file.tellg()) : -1;
+    cp.io(pos);
+    if (cp.is_loading() && pos >= 0) {
+        file.clear();
+        file.seekg(pos);
+    }
+    cp.io(line_record);
+    cp.io(has_line_record);
+    cp.io(line_record_valid);
 
-    pos = line.find_first_not_of(' ', pos+end);
-    if (pos != string::npos){
-        has_write = true;
-        write_addr = stoul(line.substr(pos), NULL, 0);
+    // binary traces
+    cp.io(next_record);
+
+    // streamed traces cannot seek, so their records are read again
+    long n = records_streamed;
+    cp.io(n);
+    while (records_streamed < n)
+        read_record(TraceReader::Format::CPU);
+
+    cp.io(has_write);
+    cp.io(write_addr);
+}
+
+void Trace::suspend()
+{
+    if (is_plain_text()) {
+        suspended_pos = file.eof() ? -1 : long(file.tellg());
+        file.close();
+    } else if (reader != nullptr) {
+        delete reader;
+        reader = nullptr;
     }
-    return true;
+}
+
+void Trace::resume()
+{
+    if (is_plain_text()) {
+        file.clear();
+        file.open(trace_name);
+        if (suspended_pos >= 0)
+            file.seekg(suspended_pos);
+        else
+            file.seekg(0, file.end);
+    } else if (use_reader) {
+        // streamed traces cannot seek, so their records are read again
+        long n = records_streamed;
+        records_streamed = 0;
+        while (records_streamed < n)
+            read_record(TraceReader::Format::CPU);
+    }
+}
+
+void Trace::read_ahead()
+{
+    if (has_line_record || !is_plain_text()) return;
+
+    // as with the TraceReader, a last line without a newline is ignored
+    getline(file, line);
+    line_record_valid = !file.eof() &&
+        TraceReader::parse(&line[0], TraceReader::Format::CPU, line_record);
+    has_line_record = true;
 }
 
 bool Trace::get_dramtrace_request(long& req_addr, Request::Type& req_type)
 {
+    if (!is_plain_text()) {
+        const BinaryTraceRecord* rec = read_record(TraceReader::Format::DRAM);
+        if (rec == nullptr)
+            return false;
+        req_addr = rec->addr;
+        req_type = (rec->flags & BinaryTraceRecord::WRITE) ?
+            Request::Type::WRITE : Request::Type::READ;
+        return true;
+    }
+
     string line;
     getline(file, line);
     if (file.eof()) {
@@ -2,10 +2,13 @@
 #define __PROCESSOR_H
 
 #include "Cache.h"
+#include "Checkpoint.h"
 #include "Config.h"
 #include "Memory.h"
 #include "Request.h"
 #include "Statistics.h"
+#include "ThreadPool.h"
+#include "TraceReader.h"
 #include <iostream>
 #include <vector>
 #include <fstream>
@@ -16,9 +19,14 @@
 namespace ramulator 
 {
 
+// Binary traces (see BinaryTraceRecord) are mapped into memory, gzip or zstd
+// compressed text traces are read by a TraceReader. Both are detected from
+// the first bytes of the file. With read_async, plain text traces are read
+// by a TraceReader, too.
 class Trace {
 public:
-    Trace(const char* trace_fname);
+    Trace(const char* trace_fname, bool read_async = false);
+    ~Trace();
     // trace file format 1:
     // [# of bubbles(non-mem instructions)] [read address(dec or hex)] <optional: write address(evicted cacheline)>
     bool get_unfiltered_request(long& bubble_cnt, long& req_addr, Request::Type& req_type);
@@ -26,10 +34,54 @@ public:
     // trace file format 2:
     // [address(hex)] [R/W]
     bool get_dramtrace_request(long& req_addr, Request::Type& req_type);
+    // Reads and parses the next line of a text trace of format 1 ahead of
+    // the request functions above, which then consume it instead of
+    // accessing the file
+    void read_ahead();
+    // Save or load the position in a trace of format 1
+    void checkpoint(Checkpoint& cp);
+    // Close the trace (and stop its reader thread) before a fork, and open
+    // it again at the same position in the forked process, which would
+    // otherwise share the file offset with its parent
+    void suspend();
+    void resume();
 
 private:
     std::ifstream file;
     std::string trace_name;
+    // text traces of format 1 are parsed a line ahead (see read_ahead)
+    std::string line;
+    BinaryTraceRecord line_record;
+    bool has_line_record = false;
+    bool line_record_valid = false; // false at the end of the trace
+
+    // compressed traces
+    TraceReader::Compression compression = TraceReader::Compression::None;
+    bool use_reader = false;
+    TraceReader* reader = nullptr;
+    BinaryTraceRecord streamed_record;
+    long records_streamed = 0; // calls to reader->next()
+    long suspended_pos = -1; // of a suspended text trace, -1 at its end
+
+    // The write-back of the last filtered request, shared by all traces
+    static bool has_write;
+    static long write_addr;
+
+    // binary traces
+    const BinaryTraceRecord* records = nullptr;
+    size_t num_records = 0;
+    size_t next_record = 0;
+    const char* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    bool is_plain_text() const {
+        return records == nullptr && !use_reader;
+    }
+    bool map_binary(const char* trace_fname);
+    // Ends the simulation on a request type (or write-back address) the
+    // request function cannot take
+    void bad_request_type();
+    const BinaryTraceRecord* read_record(TraceReader::Format format); // nullptr at the end
 };
 
 
@@ -43,7 +95,9 @@ public:
     bool is_empty();
     void insert(bool ready, long addr);
     long retire();
+    bool can_retire();
     void set_ready(long addr, int mask);
+    void checkpoint(Checkpoint& cp);
 
 private:
     int load = 0;
@@ -66,12 +120,37 @@ public:
         function<bool(Request)> send_next, Cache* llc,
         std::shared_ptr<CacheSystem> cachesys, MemoryBase& memory);
     void tick();
+    // tick() in two parts: tick_private() retires and inserts non-memory
+    // instructions and parses the next trace line, touching nothing outside
+    // of this core, so it may run concurrently with other cores.
+    // tick_shared() sends the memory request (if any) and fetches the next
+    // one from the trace. With send_privately, tick_private() already does
+    // both, and tick_shared() only replays the shared_ops of the private
+    // caches and assigns a new page to the next request.
+    void tick_private();
+    void tick_shared();
+    bool send_privately = false;
+    // Whether tick() can do nothing but advance clk until a response arrives
+    bool is_idle();
+    void skip(long cycles);
+    // Executes up to insts instructions functionally (see Cache::warm),
+    // without advancing clk, and returns how many it executed, fewer only
+    // at the end of the trace
+    long fast_forward(long insts);
     void receive(Request& req);
     void reset_stats();
     double calc_ipc();
     bool finished();
     bool has_reached_limit();
     long get_insts(); // the number of the instructions issued to the core
+    // With drain, the core retires the instructions in its window but does
+    // not issue any more, until its state can be checkpointed
+    void drain(bool drain) { draining = drain; }
+    bool is_drained() { return window.is_empty(); }
+    void checkpoint(Checkpoint& cp);
+    // See Trace::suspend
+    void suspend() { trace.suspend(); }
+    void resume() { trace.resume(); }
     function<void(Request&)> callback;
 
     bool no_core_caches = true;
@@ -91,6 +170,7 @@ public:
     ScalarStat record_cycs;
     ScalarStat record_insts;
     long expected_limit_insts;
+    long fast_forwarded = 0; // not counted in get_insts()
     // This is set true iff expected number of instructions has been executed or all instructions are executed.
     bool reached_limit = false;
 
@@ -104,6 +184,16 @@ private:
     bool more_reqs;
     long last = 0;
 
+    bool send_ready = false; // tick_private() reached the memory request
+    bool record_pending = false; // memory.record_core() is left to tick_shared()
+    bool page_pending = false; // memory.page_allocator() is left to tick_shared()
+    bool draining = false;
+    std::shared_ptr<CacheSystem> cachesys;
+    DeferredOps shared_ops;
+
+    void send_request(); // and fetch the next one
+    void record_core();
+
     ScalarStat memory_access_cycles;
     ScalarStat cpu_inst;
     MemoryBase& memory;
@@ -113,12 +203,31 @@ class Processor {
 public:
     Processor(const Config& configs, vector<std::string> trace_list,
         function<bool(Request)> send, function<bool(long)> upgrade_prefetch_req, MemoryBase& memory);
+    ~Processor();
     void tick();
+    // The number of upcoming tick() calls that only advance the clocks, and
+    // fast-forwarding over them
+    long get_idle_cycles();
+    void skip(long cycles);
+    // Fast-forwards each core over insts instructions (see
+    // Core::fast_forward), FAST_FORWARD_BATCH instructions of a core at a
+    // time, and returns the total
+    static const long FAST_FORWARD_BATCH = 100;
+    long fast_forward(long insts);
     void receive(Request& req);
     void reset_stats();
     bool finished();
     bool has_reached_limit();
     long get_insts(); // the total number of instructions issued to all cores
+    // See Core::drain
+    void drain(bool drain);
+    bool is_drained();
+    void checkpoint(Checkpoint& cp);
+    // Stop the worker threads and suspend the traces before a fork, and
+    // resume the traces in the forked process, which then ticks the cores
+    // on one thread (see run_sweep)
+    void suspend();
+    void resume();
 
     std::vector<std::unique_ptr<Core>> cores;
     std::vector<double> ipcs;
@@ -139,6 +248,10 @@ public:
     Cache llc;
 
     ScalarStat cpu_cycles;
+
+private:
+    ThreadPool* thread_pool = nullptr;
+    function<void(int)> tick_core_private;
 };
 
 }
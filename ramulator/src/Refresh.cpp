@@ -250,6 +250,12 @@ void Refresh<DSARP>::tick_ref() {
   if ((clk - refreshed) >= refresh_interval)
     inject_refresh(b_ref_rank);
 }
+
+// DSARP may pull in refreshes early on any cycle
+template<>
+long Refresh<DSARP>::get_next_refresh() {
+  return clk + 1;
+}
 /**** End DSARP specialization ****/
 
 } /* namespace ramulator */
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <vector>
 
+#include "Checkpoint.h"
 #include "Request.h"
 #include "DSARP.h"
 #include "ALDRAM.h"
@@ -83,6 +84,22 @@ public:
     }
   }
 
+  // The earliest refresh clock at which tick_ref() injects a refresh
+  long get_next_refresh() {
+    return refreshed + ctrl->channel->spec->speed_entry.nREFI;
+  }
+
+  void checkpoint(Checkpoint& cp) {
+    cp.io(clk);
+    cp.io(refreshed);
+    cp.io(bank_ref_counters);
+    for (auto backlog : bank_refresh_backlog)
+      cp.io(*backlog);
+    cp.io(subarray_ref_counters);
+    cp.io(max_sa_count);
+    cp.io(ctrl_write_mode);
+  }
+
 private:
   // Keeping track of refresh status of every bank: + means ahead of schedule, - means behind schedule
   vector<vector<int>*> bank_refresh_backlog;
@@ -98,7 +115,7 @@ private:
   // Refresh based on the specified address
   void refresh_target(Controller<T>* ctrl, int rank, int bank, int sa)
   {
-    vector<int> addr_vec(int(T::Level::MAX), -1);
+    AddrVec addr_vec(int(T::Level::MAX), -1);
     addr_vec[0] = ctrl->channel->id;
     addr_vec[1] = rank;
     addr_vec[2] = bank;
@@ -132,6 +149,7 @@ private:
 // where to look for these definitions when controller calls them!
 template<> Refresh<DSARP>::Refresh(Controller<DSARP>* ctrl);
 template<> void Refresh<DSARP>::tick_ref();
+template<> long Refresh<DSARP>::get_next_refresh();
 
 } /* namespace ramulator */
 
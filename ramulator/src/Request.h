@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <functional>
+#include "AddrVec.h"
 
 using namespace std;
 
@@ -15,7 +16,7 @@ public:
     bool is_first_command;
     long addr;
     // long addr_row;
-    vector<int> addr_vec;
+    AddrVec addr_vec;
     // specify which core this request sent from, for virtual address translation
     int coreid;
     bool marked; // a flag that is used by some schedulers, e.g., PARBS
@@ -35,7 +36,7 @@ public:
     } type;
 
     long arrive = -1;
-    long depart;
+    long depart = -1;
     function<void(Request&)> callback; // call back with more info
     function<void(Request&)> proc_callback; // FIXME: ugly workaround
 
@@ -46,7 +47,7 @@ public:
     Request(long addr, Type type, function<void(Request&)> callback, int coreid = 0)
         : is_first_command(true), addr(addr), coreid(coreid), marked(false), type(type), callback(callback) {}
 
-    Request(vector<int>& addr_vec, Type type, function<void(Request&)> callback, int coreid = 0)
+    Request(const AddrVec& addr_vec, Type type, function<void(Request&)> callback, int coreid = 0)
         : is_first_command(true), addr_vec(addr_vec), coreid(coreid), marked(false), type(type), callback(callback) {}
 
     Request()
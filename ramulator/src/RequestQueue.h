@@ -0,0 +1,191 @@
+#ifndef __REQUESTQUEUE_H
+#define __REQUESTQUEUE_H
+
+#include "Request.h"
+#include <vector>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+namespace ramulator
+{
+
+/* A list of Requests with the interface and the stable iterators of the
+ * std::list<Request> it replaces in Controller::Queue. The nodes live in a
+ * pool that is allocated once with the queue capacity and recycled on
+ * erase(), so no memory is allocated per request in steady state (a recycled
+ * node also reuses the storage of its addr_vec). The pool grows if more
+ * requests than the capacity are pushed; iterators stay valid in that case,
+ * as they are indices into the pool.
+ *
+ * The nodes are also chained into a hash table on Request::addr, so that
+ * find() (read-after-write forwarding, prefetch upgrades) does not scan the
+ * whole queue. Requests are only appended at the back, so each hash chain,
+ * which is prepended to, lists the requests of a bucket from youngest to
+ * oldest. */
+class RequestQueue
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Request value_type;
+        typedef ptrdiff_t difference_type;
+        typedef Request* pointer;
+        typedef Request& reference;
+
+        iterator() {}
+        iterator(RequestQueue* q, int idx) : q(q), idx(idx) {}
+
+        Request& operator*() const { return q->nodes[idx].req; }
+        Request* operator->() const { return &q->nodes[idx].req; }
+        iterator& operator++() { idx = q->nodes[idx].next; return *this; }
+        iterator operator++(int) { iterator it = *this; ++*this; return it; }
+        iterator& operator--() { idx = (idx == -1) ? q->tail : q->nodes[idx].prev; return *this; }
+        iterator operator--(int) { iterator it = *this; --*this; return it; }
+        bool operator==(const iterator& other) const { return idx == other.idx; }
+        bool operator!=(const iterator& other) const { return idx != other.idx; }
+
+    private:
+        friend class RequestQueue;
+        RequestQueue* q = nullptr;
+        int idx = -1;
+    };
+
+    RequestQueue(int capacity = 0) { reserve(capacity); }
+
+    void reserve(int capacity)
+    {
+        while (int(nodes.size()) < capacity) {
+            nodes.emplace_back();
+            nodes.back().next = free_list;
+            free_list = nodes.size() - 1;
+        }
+        if (buckets.empty() || 2 * nodes.size() > buckets.size())
+            rehash();
+    }
+
+    iterator begin() { return iterator(this, head); }
+    iterator end() { return iterator(this, -1); }
+    unsigned int size() const { return count; }
+    bool empty() const { return count == 0; }
+    Request& front() { return nodes[head].req; }
+    Request& back() { return nodes[tail].req; }
+
+    // the oldest request to addr, or end()
+    iterator find(long addr)
+    {
+        int found = -1;
+        for (int idx = buckets[bucket(addr)]; idx != -1; idx = nodes[idx].hnext)
+            if (nodes[idx].req.addr == addr)
+                found = idx;
+        return iterator(this, found);
+    }
+
+    void push_back(const Request& req)
+    {
+        int idx = alloc();
+        nodes[idx].req = req;
+        link_back(idx);
+        link_hash(idx);
+    }
+
+    void pop_front() { erase(begin()); }
+    void pop_back() { erase(iterator(this, tail)); }
+
+    iterator erase(iterator it)
+    {
+        int idx = it.idx;
+        Node& n = nodes[idx];
+        int next = n.next;
+
+        if (n.prev == -1) head = n.next;
+        else nodes[n.prev].next = n.next;
+        if (n.next == -1) tail = n.prev;
+        else nodes[n.next].prev = n.prev;
+
+        if (n.hprev == -1) buckets[bucket(n.req.addr)] = n.hnext;
+        else nodes[n.hprev].hnext = n.hnext;
+        if (n.hnext != -1) nodes[n.hnext].hprev = n.hprev;
+
+        n.next = free_list;
+        free_list = idx;
+        count--;
+
+        return iterator(this, next);
+    }
+
+    void clear()
+    {
+        while (head != -1)
+            erase(begin());
+    }
+
+private:
+    struct Node {
+        Request req;
+        int prev = -1;
+        int next = -1;
+        int hprev = -1;
+        int hnext = -1;
+    };
+
+    vector<Node> nodes;
+    vector<int> buckets; // heads of the hash chains, a power of two of them
+    int bucket_bits = 0;
+    int head = -1, tail = -1;
+    int free_list = -1;
+    unsigned int count = 0;
+
+    int alloc()
+    {
+        if (free_list == -1)
+            reserve(nodes.size() ? 2 * nodes.size() : 1);
+        int idx = free_list;
+        free_list = nodes[idx].next;
+        return idx;
+    }
+
+    void link_back(int idx)
+    {
+        nodes[idx].prev = tail;
+        nodes[idx].next = -1;
+        if (tail == -1) head = idx;
+        else nodes[tail].next = idx;
+        tail = idx;
+        count++;
+    }
+
+    int bucket(long addr) const
+    {
+        // Fibonacci hashing, as the low bits of line addresses are all zero
+        return int((uint64_t(addr) * 0x9E3779B97F4A7C15ULL) >> (64 - bucket_bits));
+    }
+
+    void link_hash(int idx)
+    {
+        int& head_idx = buckets[bucket(nodes[idx].req.addr)];
+        nodes[idx].hprev = -1;
+        nodes[idx].hnext = head_idx;
+        if (head_idx != -1) nodes[head_idx].hprev = idx;
+        head_idx = idx;
+    }
+
+    void rehash()
+    {
+        bucket_bits = max(bucket_bits, 1);
+        while ((size_t(1) << bucket_bits) < 2 * nodes.size())
+            bucket_bits++;
+        buckets.assign(size_t(1) << bucket_bits, -1);
+        for (int idx = head; idx != -1; idx = nodes[idx].next)
+            link_hash(idx);
+    }
+};
+
+} /*namespace ramulator*/
+
+#endif /*__REQUESTQUEUE_H*/
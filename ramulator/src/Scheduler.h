@@ -10,6 +10,7 @@
 #include <vector>
 #include <map>
 #include <list>
+#include <limits>
 #include <functional>
 #include <cassert>
 
@@ -67,13 +68,22 @@ public:
     }
 
 
-    list<Request>::iterator get_head(list<Request>& q)
+    void checkpoint(Checkpoint& cp)
+    {
+        if (sched_base != NULL)
+            sched_base->checkpoint(cp);
+    }
+
+    RequestQueue::iterator get_head(RequestQueue& q)
     {
       // TODO make the decision at compile time
       if (type != Type::FRFCFS_PriorHit) {
         if (!q.size())
             return q.end();
 
+        if (type == Type::FRFCFS || type == Type::FRFCFS_Cap)
+            return get_first_ready(q, type);
+
         auto head = q.begin();
         for (auto itr = next(q.begin(), 1); itr != q.end(); itr++)
             head = compare[int(type)](head, itr);
@@ -83,30 +93,28 @@ public:
         if (!q.size())
             return q.end();
 
-        auto head = q.begin();
-        for (auto itr = next(q.begin(), 1); itr != q.end(); itr++) {
-            head = compare[int(Type::FRFCFS_PriorHit)](head, itr);
-        }
+        auto head = get_first_ready(q, Type::FRFCFS_PriorHit);
 
         if (this->ctrl->is_ready(head) && this->ctrl->is_row_hit(head)) {
           return head;
         }
 
         // prepare a list of hit request
-        vector<vector<int>> hit_reqs;
+        vector<AddrVec> hit_reqs;
         for (auto itr = q.begin() ; itr != q.end() ; ++itr) {
           if (this->ctrl->is_row_hit(itr)) {
             auto begin = itr->addr_vec.begin();
             // TODO Here it assumes all DRAM standards use PRE to close a row
             // It's better to make it more general.
             auto end = begin + int(ctrl->channel->spec->scope[int(T::Command::PRE)]) + 1;
-            vector<int> rowgroup(begin, end); // bank or subarray
+            AddrVec rowgroup(begin, end); // bank or subarray
             hit_reqs.push_back(rowgroup);
           }
         }
         // if we can't find proper request, we need to return q.end(),
         // so that no command will be scheduled
         head = q.end();
+        bool head_ready = false;
         for (auto itr = q.begin(); itr != q.end(); itr++) {
           bool violate_hit = false;
           if ((!this->ctrl->is_row_hit(itr)) && this->ctrl->is_row_open(itr)) {
@@ -115,7 +123,7 @@ public:
             // TODO Here it assumes all DRAM standards use PRE to close a row
             // It's better to make it more general.
             auto end = begin + int(ctrl->channel->spec->scope[int(T::Command::PRE)]) + 1;
-            vector<int> rowgroup(begin, end); // bank or subarray
+            AddrVec rowgroup(begin, end); // bank or subarray
             for (const auto& hit_req_rowgroup : hit_reqs) {
               if (rowgroup == hit_req_rowgroup) {
                   violate_hit = true;
@@ -127,10 +135,10 @@ public:
             continue;
           }
           // If it comes here, that means it won't violate any hit request
-          if (head == q.end()) {
+          bool ready = this->ctrl->is_ready(itr);
+          if (head == q.end() || is_before(ready, itr, head_ready, head)) {
             head = itr;
-          } else {
-            head = compare[int(Type::FRFCFS)](head, itr);
+            head_ready = ready;
           }
         }
 
@@ -139,7 +147,42 @@ public:
     }
 
 private:
-    typedef list<Request>::iterator ReqIter;
+    typedef RequestQueue::iterator ReqIter;
+
+    // Whether the FR-FCFS variant t counts req as ready, as in compare[t]
+    bool is_first_ready(ReqIter req, Type t)
+    {
+        bool ready = this->ctrl->is_ready(req);
+        if (t == Type::FRFCFS_Cap)
+            ready = ready && (this->ctrl->rowtable->get_hits(req->addr_vec) <= this->cap);
+        else if (t == Type::FRFCFS_PriorHit)
+            ready = ready && this->ctrl->is_row_hit(req);
+        return ready;
+    }
+
+    // Whether compare[t](head, req) picks req, given both readiness values
+    static bool is_before(bool ready, ReqIter req, bool head_ready, ReqIter head)
+    {
+        if (ready ^ head_ready)
+            return ready;
+        return !(head->arrive <= req->arrive);
+    }
+
+    // Same as folding compare[t] over q, but it evaluates the readiness of
+    // each request once rather than the head's again on every comparison
+    ReqIter get_first_ready(RequestQueue& q, Type t)
+    {
+        auto head = q.begin();
+        bool head_ready = is_first_ready(head, t);
+        for (auto itr = next(q.begin(), 1); itr != q.end(); itr++) {
+            bool ready = is_first_ready(itr, t);
+            if (is_before(ready, itr, head_ready, head)) {
+                head = itr;
+                head_ready = ready;
+            }
+        }
+        return head;
+    }
     function<ReqIter(ReqIter, ReqIter)> compare[int(Type::MAX)] = {
         // FCFS
         [this] (ReqIter req1, ReqIter req2) {
@@ -221,37 +264,56 @@ public:
     
     }
 
-    vector<int> get_victim(typename T::Command cmd)
+    AddrVec get_victim(typename T::Command cmd)
     {
         return policy[int(type)](cmd);
     }
 
+    // The earliest clock at which get_victim() may return a row
+    long get_next_victim(typename T::Command cmd)
+    {
+        long next_victim = numeric_limits<long>::max();
+        if (type == Type::Opened)
+            return next_victim;
+
+        auto rowtable = ctrl->rowtable;
+        for (int slot : rowtable->opened) {
+            long ready = ctrl->get_next_ready(cmd, rowtable->rowgroups[slot]);
+            if (type == Type::Timeout)
+                ready = max(ready, rowtable->entries[slot].timestamp + timeout);
+            next_victim = min(next_victim, ready);
+        }
+        return next_victim;
+    }
+
 private:
-    function<vector<int>(typename T::Command)> policy[int(Type::MAX)] = {
+    function<AddrVec(typename T::Command)> policy[int(Type::MAX)] = {
         // Closed
-        [this] (typename T::Command cmd) -> vector<int> {
-            for (auto& kv : this->ctrl->rowtable->table) {
-                if (!this->ctrl->is_ready(cmd, kv.first))
+        [this] (typename T::Command cmd) -> AddrVec {
+            auto rowtable = this->ctrl->rowtable;
+            for (int slot : rowtable->opened) {
+                if (!this->ctrl->is_ready(cmd, rowtable->rowgroups[slot]))
                     continue;
-                return kv.first;
+                return rowtable->rowgroups[slot];
             }
-            return vector<int>();},
+            return AddrVec();},
 
         // Opened
         [this] (typename T::Command cmd) {
-            return vector<int>();},
+            return AddrVec();},
 
         // Timeout
-        [this] (typename T::Command cmd) -> vector<int> {
-            for (auto& kv : this->ctrl->rowtable->table) {
-                auto& entry = kv.second;
+        [this] (typename T::Command cmd) -> AddrVec {
+            auto rowtable = this->ctrl->rowtable;
+            for (int slot : rowtable->opened) {
+                auto& entry = rowtable->entries[slot];
                 if (this->ctrl->clk - entry.timestamp < timeout)
                     continue;
-                if (!this->ctrl->is_ready(cmd, kv.first))
+                if (!this->ctrl->is_ready(cmd, rowtable->rowgroups[slot]))
                     continue;
-                return kv.first;
+                return rowtable->rowgroups[slot];
             }
-            return vector<int>();}
+            return AddrVec();}
     };
 
 };
@@ -269,39 +331,51 @@ public:
         long timestamp;
     };
 
-    map<vector<int>, Entry> table;
+    // The open row of each bank (or subarray) lives in the slot
+    // ctrl->get_bank_index() assigns to it. opened lists the occupied slots
+    // in address order, which is the order the row policies scan them in.
+    vector<Entry> entries;
+    vector<AddrVec> rowgroups;
+    vector<int> opened;
 
     RowTable(Controller<T>* ctrl) : ctrl(ctrl) {}
 
-    void update(typename T::Command cmd, const vector<int>& addr_vec, long clk)
+    void update(typename T::Command cmd, const AddrVec& addr_vec, long clk)
     {
         auto begin = addr_vec.begin();
         auto end = begin + int(T::Level::Row);
-        vector<int> rowgroup(begin, end); // bank or subarray
         int row = *end;
 
         T* spec = ctrl->channel->spec;
 
-        if (spec->is_opening(cmd))
-            table.insert({rowgroup, {row, 0, clk}});
+        if (spec->is_opening(cmd)) {
+            int slot = get_slot(addr_vec);
+            if (!is_open[slot]) {
+                is_open[slot] = true;
+                opened.insert(lower_bound(opened.begin(), opened.end(), slot), slot);
+                entries[slot] = {row, 0, clk};
+                rowgroups[slot] = AddrVec(begin, end); // bank or subarray
+            }
+        }
 
         if (spec->is_accessing(cmd)) {
             // we are accessing a row -- update its entry
-            auto match = table.find(rowgroup);
-            assert(match != table.end());
-            assert(match->second.row == row);
-            match->second.hits++;
-            match->second.timestamp = clk;
+            Entry* match = find(addr_vec);
+            assert(match != nullptr);
+            assert(match->row == row);
+            match->hits++;
+            match->timestamp = clk;
         } /* accessing */
 
         if (spec->is_closing(cmd)) {
           // we are closing one or more rows -- remove their entries
           int n_rm = 0;
           int scope = int(spec->scope[int(cmd)]);
-          for (auto it = table.begin(); it != table.end();) {
-            if (equal(begin, begin + scope + 1, it->first.begin())) {
+          for (auto it = opened.begin(); it != opened.end();) {
+            if (equal(begin, begin + scope + 1, rowgroups[*it].begin())) {
               n_rm++;
-              it = table.erase(it);
+              is_open[*it] = false;
+              it = opened.erase(it);
             }
             else
               it++;
@@ -310,35 +384,77 @@ public:
         } /* closing */
     }
 
-    int get_hits(const vector<int>& addr_vec, const bool to_opened_row = false)
+    int get_hits(const AddrVec& addr_vec, const bool to_opened_row = false)
     {
-        auto begin = addr_vec.begin();
-        auto end = begin + int(T::Level::Row);
-
-        vector<int> rowgroup(begin, end);
-        int row = *end;
+        int row = addr_vec[int(T::Level::Row)];
 
-        auto itr = table.find(rowgroup);
-        if (itr == table.end())
+        Entry* match = find(addr_vec);
+        if (match == nullptr)
             return 0;
 
-        if(!to_opened_row && (itr->second.row != row))
+        if(!to_opened_row && (match->row != row))
             return 0;
 
-        return itr->second.hits;
+        return match->hits;
     }
 
-    int get_open_row(const vector<int>& addr_vec) {
-        auto begin = addr_vec.begin();
-        auto end = begin + int(T::Level::Row);
+    int get_open_row(const AddrVec& addr_vec) {
+        Entry* match = find(addr_vec);
+        if(match == nullptr)
+            return -1;
 
-        vector<int> rowgroup(begin, end);
+        return match->row;
+    }
 
-        auto itr = table.find(rowgroup);
-        if(itr == table.end())
-            return -1;
+    // Moves the open rows to the slots of their banks once the controller
+    // renumbered the banks (SALP adding subarrays in reload_options())
+    void reindex()
+    {
+        vector<Entry> old_entries;
+        vector<AddrVec> old_rowgroups;
+        vector<int> old_opened;
+        old_entries.swap(entries);
+        old_rowgroups.swap(rowgroups);
+        old_opened.swap(opened);
+        is_open.clear();
+
+        for (int old_slot : old_opened) {
+            int slot = get_slot(old_rowgroups[old_slot]);
+            is_open[slot] = true;
+            opened.insert(lower_bound(opened.begin(), opened.end(), slot), slot);
+            entries[slot] = old_entries[old_slot];
+            rowgroups[slot] = old_rowgroups[old_slot];
+        }
+    }
+
+    void checkpoint(Checkpoint& cp)
+    {
+        cp.io(entries);
+        cp.io(rowgroups);
+        cp.io(opened);
+        cp.io(is_open);
+    }
+
+private:
+    vector<bool> is_open;
+
+    int get_slot(const AddrVec& addr_vec)
+    {
+        if (entries.empty()) {
+            int banks = ctrl->get_num_banks();
+            entries.resize(banks);
+            rowgroups.resize(banks);
+            is_open.resize(banks, false);
+        }
+        return ctrl->get_bank_index(addr_vec);
+    }
 
-        return itr->second.row;
+    Entry* find(const AddrVec& addr_vec)
+    {
+        int slot = get_slot(addr_vec);
+        if (slot < 0 || !is_open[slot])
+            return nullptr;
+        return &entries[slot];
     }
 };
 
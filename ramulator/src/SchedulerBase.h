@@ -1,14 +1,15 @@
 #ifndef SCHEDULERBASE_H
 #define SCHEDULERBASE_H
 
-#include "Request.h"
+#include "Checkpoint.h"
+#include "RequestQueue.h"
 #include <list>
 namespace ramulator{
 
 template <typename T>
 class SchedulerBase{
 public:
-    typedef std::list<Request>::iterator ReqIter;
+    typedef RequestQueue::iterator ReqIter;
     virtual ReqIter better_req(ReqIter req1, ReqIter req2) = 0;
     virtual void set_num_cores(int) = 0;
     virtual void Tick() = 0;
@@ -24,6 +25,8 @@ public:
     virtual void increment_wr_req_count(int core){}
     virtual void increment_instruction_count(int core){}
 
+    virtual void checkpoint(Checkpoint& cp){}
+
 
 };
 }
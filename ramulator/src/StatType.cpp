@@ -1,4 +1,5 @@
 #include "StatType.h"
+#include <cstdio>
 
 namespace Stats {
 
@@ -14,6 +15,121 @@ void reset_stats() {
         s->reset();
 }
 
+// A value in the structured formats: JSON has no NaN or infinity
+static void write_value(std::ofstream& file, Result value, Format format)
+{
+    char buf[32];
+    if (std::isfinite(value))
+        snprintf(buf, sizeof(buf), "%.15g", value);
+    else if (format == Format::JSON)
+        snprintf(buf, sizeof(buf), "null");
+    else
+        snprintf(buf, sizeof(buf), "%s", std::isnan(value) ? "nan" : (value > 0 ? "inf" : "-inf"));
+    file << buf;
+}
+
+void StatList::collect(NamedResults& values, std::vector<ValueKey>* keys)
+{
+    for (auto stat : list) {
+        if (!stat || (stat->is_nozero() && stat->zero()) || !stat->is_display())
+            continue;
+        stat->prepare();
+        size_t first = values.size();
+        stat->collect(values);
+        if (keys != nullptr) {
+            for (size_t i = first; i < values.size(); i++)
+                keys->push_back(ValueKey(stat, i - first));
+        }
+    }
+}
+
+void StatList::printall()
+{
+    if (stat_format == Format::Text) {
+        for(off_type i = 0 ; i < list.size() ; ++i) {
+            if (!list[i]) {
+                continue;
+            }
+            if (list[i]->is_nozero() && list[i]->zero()) {
+                continue;
+            }
+            if (list[i]->is_display()) {
+                list[i]->prepare();
+                list[i]->print(stat_output);
+            }
+        }
+        return;
+    }
+
+    NamedResults values;
+    collect(values);
+    if (stat_format == Format::JSON) {
+        stat_output << "{";
+        for (size_t i = 0; i < values.size(); i++) {
+            stat_output << (i ? ", \"" : "\"") << values[i].first << "\": ";
+            write_value(stat_output, values[i].second, stat_format);
+        }
+        stat_output << "}\n";
+    } else {
+        stat_output << "name,value\n";
+        for (auto& value : values) {
+            stat_output << value.first << ",";
+            write_value(stat_output, value.second, stat_format);
+            stat_output << "\n";
+        }
+    }
+}
+
+void StatList::start_epochs(std::string filename, Tick cycles)
+{
+    epoch_output.open(filename.c_str(), std::ios_base::out);
+    if (!epoch_output.good()) {
+        assert(false && "!epoch_output.good()");
+    }
+    if (stat_format == Format::CSV)
+        epoch_output << "epoch,tick,name,value\n";
+
+    NamedResults values;
+    std::vector<ValueKey> keys;
+    collect(values, &keys);
+    epoch_base.clear();
+    for (size_t i = 0; i < values.size(); i++)
+        epoch_base[keys[i]] = values[i].second;
+
+    epoch_cycles = cycles;
+    next_epoch = curTick + cycles;
+    epochs = 0;
+}
+
+void StatList::write_epoch()
+{
+    NamedResults values;
+    std::vector<ValueKey> keys;
+    collect(values, &keys);
+
+    // a JSON line per epoch, or a CSV line per value
+    if (stat_format != Format::CSV)
+        epoch_output << "{\"epoch\": " << epochs << ", \"tick\": " << curTick;
+    for (size_t i = 0; i < values.size(); i++) {
+        auto& value = values[i];
+        Result& base = epoch_base[keys[i]];
+        Result delta = value.second - base;
+        base = value.second;
+        if (stat_format == Format::CSV) {
+            epoch_output << epochs << "," << curTick << "," << value.first << ",";
+            write_value(epoch_output, delta, stat_format);
+            epoch_output << "\n";
+        } else {
+            epoch_output << ", \"" << value.first << "\": ";
+            write_value(epoch_output, delta, Format::JSON);
+        }
+    }
+    if (stat_format != Format::CSV)
+        epoch_output << "}\n";
+    epoch_output.flush();
+    epochs++;
+}
+
 void
 Histogram::grow_out()
 {
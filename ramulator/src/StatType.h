@@ -3,7 +3,9 @@
 
 #include <limits>
 #include <fstream>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 #include <algorithm>
 
@@ -31,11 +33,14 @@ typedef uint64_t Tick;
 typedef std::vector<Counter> VCounter;
 typedef std::vector<Result> VResult;
 typedef std::numeric_limits<Counter> CounterLimits;
+typedef std::vector<std::pair<std::string, Result>> NamedResults;
 
 class StatBase;
 extern std::vector<StatBase*> all_stats;
 void reset_stats();
 
+extern Tick curTick;
+
 // Flags
 const uint16_t init      = 0x00000001;
 const uint16_t display   = 0x00000002;
@@ -71,6 +76,9 @@ class StatBase {
   // TODO implement print for Distribution, Histogram,
   // AverageDeviation, StandardDeviation
   virtual void print(std::ofstream& file) = 0;
+  // Appends the values print() writes, with their names, for the
+  // structured formats
+  virtual void collect(NamedResults& values) = 0;
 
   virtual size_type size() const = 0;
   virtual bool zero() const = 0;
@@ -86,10 +94,33 @@ class StatBase {
 
 
 
+// The format of the statistics (see stats_format in Config.h)
+enum class Format {
+  Text, // gem5 style, one line per value
+  JSON, // one JSON object of the values by name
+  CSV,  // name,value lines
+};
+
 class StatList {
  protected:
   std::vector<StatBase*> list;
   std::ofstream stat_output;
+  Format stat_format = Format::Text;
+
+  // The epochs (see stats_epoch_cycles in Config.h)
+  std::ofstream epoch_output;
+  Tick epoch_cycles = 0;
+  Tick next_epoch = 0;
+  long epochs = 0;
+  // The values at the last epoch, by stat and position among its values,
+  // as names are not unique
+  typedef std::pair<const StatBase*, size_t> ValueKey;
+  std::map<ValueKey, Result> epoch_base;
+
+  // Appends the displayed values, and their keys if keys is given
+  void collect(NamedResults& values, std::vector<ValueKey>* keys = nullptr);
+  void write_epoch();
+
  public:
   void add(StatBase* stat) {
     list.push_back(stat);
@@ -98,25 +129,49 @@ class StatList {
     list.erase(std::find(list.begin(), list.end(), stat));
   }
   void output(std::string filename) {
+    if (stat_output.is_open()) {
+      stat_output.close();
+    }
     stat_output.open(filename.c_str(), std::ios_base::out);
     if (!stat_output.good()) {
       assert(false && "!stat_output.good()");
     }
   }
-  void printall() {
-    for(off_type i = 0 ; i < list.size() ; ++i) {
-      if (!list[i]) {
-        continue;
-      }
-      if (list[i]->is_nozero() && list[i]->zero()) {
-        continue;
-      }
-      if (list[i]->is_display()) {
-        list[i]->prepare();
-        list[i]->print(stat_output);
-      }
+  void format(Format f) {
+    stat_format = f;
+  }
+  void printall();
+
+  // From now on, every cycles ticks, write the change of each value since
+  // the previous epoch (or since now) to filename, in the format of the
+  // statistics (JSON lines for Text)
+  void start_epochs(std::string filename, Tick cycles);
+  // Called after advancing curTick. The boundaries stay multiples of
+  // cycles after the start, however far curTick jumped past them.
+  void check_epoch() {
+    if (epoch_cycles != 0 && curTick >= next_epoch) {
+      write_epoch();
+      while (next_epoch <= curTick)
+        next_epoch += epoch_cycles;
+    }
+  }
+  // The ticks until the next epoch boundary, which skipping idle cycles
+  // should not pass
+  Tick ticks_to_epoch() const {
+    if (epoch_cycles == 0)
+      return std::numeric_limits<Tick>::max();
+    return next_epoch - curTick;
+  }
+  // Writes the last, partial epoch, so that the changes of a value add
+  // up to its final value
+  void finish_epochs() {
+    if (epoch_cycles != 0) {
+      write_epoch();
+      epoch_cycles = 0;
+      epoch_output.close();
     }
   }
+
   ~StatList() {
     stat_output.close();
   }
@@ -175,6 +230,7 @@ class Stat : public StatBase {
   size_type size() const { return 0; }
 
   virtual void print(std::ofstream& file) {};
+  virtual void collect(NamedResults& values) {};
   virtual void printname(std::ofstream& file) {
     file.width(40);
     file << _name;
@@ -213,6 +269,11 @@ class ScalarBase: public Stat<ScalarType> {
     file << std::fixed << res;
     Stat<ScalarType>::printdesc(file);
   }
+
+  virtual void collect(NamedResults& values) {
+    values.push_back(std::make_pair(Stat<ScalarType>::_name,
+        Stat<ScalarType>::self().result()));
+  }
 };
 
 class ConstValue: public ScalarBase<ConstValue> {
@@ -274,8 +335,6 @@ class Scalar: public ScalarBase<Scalar> {
 
 };
 
-extern Tick curTick;
-
 class Average: public ScalarBase<Average> {
  private:
   Counter current;
@@ -412,6 +471,14 @@ class VectorBase: public Stat<Derived> {
       data[i].print(file);
     }
   }
+  void collect(NamedResults& values) {
+    values.push_back(std::make_pair(Stat<Derived>::_name, total()));
+    for (off_type i = 0 ; i < size() ; ++i) {
+      values.push_back(std::make_pair(
+          Stat<Derived>::_name + "[" + std::to_string(i) + "]",
+          data[i].result()));
+    }
+  }
 };
 
 class Vector: public VectorBase<Vector, Scalar> {
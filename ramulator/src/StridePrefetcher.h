@@ -9,6 +9,7 @@
 #define STRIDE_REGION(x) ( x >> (PREF_STRIDE_REGION_BITS) )
 
 #include <functional>
+#include "Checkpoint.h"
 #include "Request.h"
 
 namespace ramulator
@@ -85,6 +86,12 @@ namespace ramulator
 
             void create_new_entry(int idx, long line_addr, long region_tag, long cur_clk);
 
+            void checkpoint(Checkpoint& cp) {
+                cp.check(num_entries, "prefetcher size");
+                cp.io(region_table, num_entries);
+                cp.io(index_table, num_entries);
+            }
+
     };
 
 } // namespace ramulator
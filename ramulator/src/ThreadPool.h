@@ -0,0 +1,111 @@
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <sched.h>
+
+using namespace std;
+
+namespace ramulator
+{
+
+/* A fixed set of worker threads for fine-grained, per-cycle parallelism.
+ * run() is a fork-join barrier: job(i) is executed for every i in [0, n) and
+ * run() returns only after all of them finished. Jobs are distributed
+ * statically (thread t executes i = t, t + size(), ...) and the calling
+ * thread participates as thread 0, so run() with size() == 1 is a plain loop.
+ * Workers spin (and eventually yield) between jobs instead of sleeping, as
+ * run() is expected to be called once every simulated cycle. */
+class ThreadPool
+{
+public:
+    ThreadPool(int num_threads) : num_threads(num_threads)
+    {
+        for (int t = 1; t < num_threads; t++)
+            workers.emplace_back(&ThreadPool::worker_loop, this, t);
+    }
+
+    ~ThreadPool()
+    {
+        stop.store(true, memory_order_release);
+        generation.fetch_add(1, memory_order_release);
+        for (auto& w : workers)
+            w.join();
+    }
+
+    int size() const { return num_threads; }
+
+    // The number of CPUs this process may run on, which may be fewer than
+    // the host has (e.g., with taskset or in a container). Spinning workers
+    // beyond it only take the CPU from the simulation thread.
+    static int available_cpus()
+    {
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            return max(CPU_COUNT(&set), 1);
+        return max(int(thread::hardware_concurrency()), 1);
+    }
+
+    void run(int n, const function<void(int)>& job)
+    {
+        if (num_threads == 1 || n == 1) {
+            for (int i = 0; i < n; i++)
+                job(i);
+            return;
+        }
+
+        cur_job = &job;
+        num_jobs = n;
+        remaining.store(num_threads - 1, memory_order_relaxed);
+        generation.fetch_add(1, memory_order_release);
+
+        run_share(0);
+
+        for (long spins = 0; remaining.load(memory_order_acquire) != 0; spins++)
+            if (spins > SPIN_LIMIT)
+                this_thread::yield();
+    }
+
+private:
+    static const long SPIN_LIMIT = 1 << 12;
+
+    int num_threads;
+    vector<thread> workers;
+
+    const function<void(int)>* cur_job = nullptr;
+    int num_jobs = 0;
+    atomic<long> generation{0};
+    atomic<int> remaining{0};
+    atomic<bool> stop{false};
+
+    void run_share(int t)
+    {
+        for (int i = t; i < num_jobs; i += num_threads)
+            (*cur_job)(i);
+    }
+
+    void worker_loop(int t)
+    {
+        long seen = 0;
+        while (true) {
+            for (long spins = 0; generation.load(memory_order_acquire) == seen; spins++)
+                if (spins > SPIN_LIMIT)
+                    this_thread::yield();
+            seen++;
+
+            if (stop.load(memory_order_acquire))
+                return;
+
+            run_share(t);
+            remaining.fetch_sub(1, memory_order_release);
+        }
+    }
+};
+
+} /*namespace ramulator*/
+
+#endif /*__THREADPOOL_H*/
@@ -0,0 +1,245 @@
+#include "TraceReader.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <chrono>
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+namespace ramulator
+{
+
+TraceReader::TraceReader(const string& trace_name, Compression compression, Format format)
+    : trace_name(trace_name), compression(compression), format(format), ring(RING_SIZE)
+{
+    worker = thread(&TraceReader::run, this);
+}
+
+TraceReader::~TraceReader()
+{
+    stop.store(true, memory_order_release);
+    worker.join();
+}
+
+TraceReader::Compression TraceReader::detect(const unsigned char* magic, size_t size)
+{
+    if (size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        return Compression::Gzip;
+    if (size >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        return Compression::Zstd;
+    return Compression::None;
+}
+
+bool TraceReader::next(BinaryTraceRecord& rec)
+{
+    if (ended)
+        return false;
+
+    while (cur_pos == cur.records.size()) {
+        if (cur.last) {
+            cur.last = false;
+            ended = (format == Format::DRAM);
+            return false;
+        }
+
+        // The simulation cannot continue without the next record: spin
+        size_t head = ring_head.load(memory_order_relaxed);
+        while (ring_tail.load(memory_order_acquire) == head)
+            this_thread::yield();
+
+        swap(cur, ring[head % RING_SIZE]);
+        ring_head.store(head + 1, memory_order_release);
+        cur_pos = 0;
+
+        if (!cur.error.empty()) {
+            cerr << cur.error << endl;
+            exit(1);
+        }
+    }
+
+    rec = cur.records[cur_pos++];
+    return true;
+}
+
+bool TraceReader::push(Chunk& chunk)
+{
+    // The reader is far enough ahead: sleep instead of competing with the
+    // simulation for the CPU
+    size_t tail = ring_tail.load(memory_order_relaxed);
+    while (tail - ring_head.load(memory_order_acquire) == RING_SIZE) {
+        if (stop.load(memory_order_acquire))
+            return false;
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+    if (stop.load(memory_order_acquire))
+        return false;
+
+    swap(ring[tail % RING_SIZE], chunk);
+    ring_tail.store(tail + 1, memory_order_release);
+
+    chunk.records.clear();
+    chunk.last = false;
+    chunk.error.clear();
+    return true;
+}
+
+// The syntax of the formats 1 (CPU) and 2 (DRAM) described in Trace, which
+// also parses its plain text CPU traces with this
+bool TraceReader::parse(char* line, Format format, BinaryTraceRecord& rec)
+{
+    if (*line == '\0')
+        return false;
+
+    char* p = line;
+    rec.bubble_cnt = 0;
+    rec.flags = 0;
+    rec.wb_addr = 0;
+
+    if (format == Format::CPU) {
+        rec.bubble_cnt = strtoul(p, &p, 10);
+        rec.addr = strtoull(p, &p, 0);
+        while (*p == ' ')
+            p++;
+        if (*p == 'W')
+            rec.flags |= BinaryTraceRecord::WRITE;
+        else if (*p != '\0' && *p != 'R') {
+            char* end;
+            rec.wb_addr = strtoull(p, &end, 0);
+            rec.flags |= (end == p) ? BinaryTraceRecord::INVALID : BinaryTraceRecord::HAS_WRITEBACK;
+        }
+    } else {
+        rec.addr = strtoull(p, &p, 16);
+        while (*p == ' ')
+            p++;
+        if (*p == 'W')
+            rec.flags |= BinaryTraceRecord::WRITE;
+    }
+    return true;
+}
+
+// Runs "zstd -dcq -- <trace>" without a shell, so that the name of the
+// trace is never interpreted, and returns the read end of its output
+FILE* TraceReader::open_zstd(pid_t& pid)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+        return nullptr;
+    // keep the pipe out of the processes forked by the simulation (sweeps)
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    const char* argv[] = {"zstd", "-dcq", "--", trace_name.c_str(), nullptr};
+    pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        execvp(argv[0], const_cast<char* const*>(argv));
+        _exit(127);
+    }
+    close(fds[1]);
+    FILE* stream = (pid < 0) ? nullptr : fdopen(fds[0], "r");
+    if (stream == nullptr)
+        close(fds[0]);
+    return stream;
+}
+
+void TraceReader::run()
+{
+    vector<char> buf(1 << 20);
+    Chunk chunk;
+    chunk.records.reserve(CHUNK_SIZE);
+
+    while (true) {
+        gzFile gz = nullptr;
+        FILE* stream = nullptr;
+        pid_t zstd = -1;
+        if (compression == Compression::None) {
+            stream = fopen(trace_name.c_str(), "r");
+        } else if (compression == Compression::Gzip) {
+            gz = gzopen(trace_name.c_str(), "rb");
+            if (gz != nullptr)
+                gzbuffer(gz, 1 << 17);
+        } else {
+            stream = open_zstd(zstd);
+        }
+        if (gz == nullptr && stream == nullptr) {
+            chunk.last = true;
+            chunk.error = "Cannot read trace file: " + trace_name;
+            push(chunk);
+            return;
+        }
+
+        // Only lines ending with a newline are parsed, as with getline()
+        // followed by an eof() check in Trace
+        size_t len = 0;
+        bool more = true;
+        bool failed = false;  // read error rather than the end of the file
+        while (more) {
+            if (len == buf.size())
+                buf.resize(buf.size() * 2);
+
+            long n = (gz != nullptr) ?
+                gzread(gz, buf.data() + len, buf.size() - len) :
+                fread(buf.data() + len, 1, buf.size() - len, stream);
+            if (n <= 0) {
+                failed = (n < 0) || (stream != nullptr && ferror(stream));
+                break;
+            }
+            len += n;
+
+            char* start = buf.data();
+            char* end = buf.data() + len;
+            char* nl;
+            while ((nl = static_cast<char*>(memchr(start, '\n', end - start)))) {
+                *nl = '\0';
+                BinaryTraceRecord rec;
+                if (!parse(start, format, rec)) {
+                    more = false;
+                    break;
+                }
+                chunk.records.push_back(rec);
+                start = nl + 1;
+                if (chunk.records.size() == CHUNK_SIZE && !push(chunk)) {
+                    more = false;
+                    break;
+                }
+            }
+
+            len = end - start;
+            memmove(buf.data(), start, len);
+        }
+
+        if (gz != nullptr) {
+            int err;
+            gzerror(gz, &err);
+            if (more && err != Z_OK)
+                failed = true;  // e.g., a truncated or corrupt file
+            gzclose(gz);
+        } else
+            fclose(stream);
+
+        // zstd only exits with 0 if it decoded the whole trace. It is killed
+        // by SIGPIPE when the trace ends early (e.g., an empty line), which
+        // is not an error.
+        if (zstd > 0) {
+            int status;
+            while (waitpid(zstd, &status, 0) < 0 && errno == EINTR)
+                ;
+            if (more && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+                failed = true;
+        }
+
+        chunk.last = true;
+        if (failed)
+            chunk.error = "Cannot decode trace file: " + trace_name;
+        if (!push(chunk) || failed || format == Format::DRAM)
+            return;
+    }
+}
+
+} /*namespace ramulator*/
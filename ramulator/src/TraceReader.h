@@ -0,0 +1,93 @@
+#ifndef __TRACEREADER_H
+#define __TRACEREADER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+namespace ramulator
+{
+
+// Binary trace format (written by trace2bin.py): a 16-byte header, i.e., the
+// magic "RAMTRACE" and a version number, followed by fixed-width records.
+// The same record is used for text traces parsed by TraceReader.
+struct BinaryTraceRecord {
+    enum Flags {
+        WRITE = 1,          // write request (format 2 and [R/W] in format 1)
+        HAS_WRITEBACK = 2,  // wb_addr holds the write address of format 1
+        INVALID = 4,        // the type of a text line of format 1 is neither R, W nor an address
+    };
+    uint32_t bubble_cnt;
+    uint32_t flags;
+    uint64_t addr;
+    uint64_t wb_addr;
+};
+
+/* Reads, decompresses and parses a text trace on a background thread.
+ * Parsed records are handed to the simulation thread in chunks through a
+ * lock-free single-producer/single-consumer ring buffer, so file I/O and
+ * decompression overlap with the simulation. gzip is decoded with zlib,
+ * zstd by piping the file through the zstd tool. A trace that cannot be
+ * read or decoded ends the simulation with an error in next().
+ *
+ * CPU traces restart from the beginning after their end has been returned
+ * once, just like Trace does with plain text files. DRAM traces do not. */
+class TraceReader
+{
+public:
+    enum class Compression {None, Gzip, Zstd};
+    enum class Format {CPU, DRAM};
+
+    TraceReader(const std::string& trace_name, Compression compression, Format format);
+    ~TraceReader();
+
+    // Returns false once at the end of the trace
+    bool next(BinaryTraceRecord& rec);
+
+    Format get_format() const { return format; }
+
+    // Detects the compression from the first bytes of a file
+    static Compression detect(const unsigned char* magic, size_t size);
+
+    // Parses a line of a text trace, and returns false for an empty line,
+    // which ends the trace
+    static bool parse(char* line, Format format, BinaryTraceRecord& rec);
+
+private:
+    static const size_t CHUNK_SIZE = 4096;  // records
+    static const size_t RING_SIZE = 16;  // chunks
+
+    struct Chunk {
+        std::vector<BinaryTraceRecord> records;
+        bool last = false;  // the trace ends after these records
+        std::string error;  // why the trace could not be read (with last)
+    };
+
+    std::string trace_name;
+    Compression compression;
+    Format format;
+
+    // Chunk i is in ring[i % RING_SIZE]. Only the consumer advances
+    // ring_head and only the producer advances ring_tail.
+    std::vector<Chunk> ring;
+    std::atomic<size_t> ring_head{0}, ring_tail{0};
+    std::atomic<bool> stop{false};
+
+    Chunk cur;  // chunk being consumed
+    size_t cur_pos = 0;
+    bool ended = false;  // a DRAM trace has been consumed
+
+    std::thread worker;
+
+    void run();
+    bool push(Chunk& chunk);  // false once the reader is being destroyed
+    FILE* open_zstd(pid_t& pid);  // nullptr if the zstd tool cannot be started
+};
+
+} /*namespace ramulator*/
+
+#endif /*__TRACEREADER_H*/
@@ -0,0 +1,105 @@
+#!/usr/bin/python
+# Checks that skipping the idle cycles does not move the epochs of the
+# statistics (stats_epoch_cycles): both runs should write their epochs at
+# the same ticks. With two cores and their private caches, it also checks
+# that the JSON statistics have unique names and that the changes in the
+# epochs add up to the final values.
+import json
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+EPOCH_CYCLES = 10000
+
+def write_traces(tmp):
+  random.seed(1)
+  cpu = os.path.join(tmp, 'cpu.trace')
+  with open(cpu, 'w') as f:
+    for i in range(20000):
+      f.write('%d %d\n' % (random.randint(0, 200), random.randrange(0, 1 << 30, 64)))
+  # reads only: the controller serves the writes left at the end of a DRAM
+  # trace only once the write queue fills up
+  dram = os.path.join(tmp, 'dram.trace')
+  with open(dram, 'w') as f:
+    for i in range(20000):
+      f.write('0x%x R\n' % random.randrange(0, 1 << 30, 64))
+  return cpu, dram
+
+def run(tmp, name, mode, traces, skip, options=()):
+  stats = os.path.join(tmp, '%s-%s.stats' % (name, skip))
+  argv = ['./ramulator', 'configs/DDR3-config.cfg', '--mode=' + mode, '--stats', stats,
+      '-p', 'warmup_insts=100000', '-p', 'stats_epoch_cycles=%d' % EPOCH_CYCLES,
+      '-p', 'skip_idle_cycles=' + skip]
+  for trace in traces:
+    argv += ['-t', trace]
+  for option in options:
+    argv += ['-p', option]
+  subprocess.check_call(argv, stdout=open(os.devnull, 'w'))
+  return stats
+
+def epoch_ticks(stats):
+  return [int(t) for t in re.findall(r'"tick": (\d+)', open(stats + '.epochs').read())]
+
+def unique_object(pairs):
+  names = [name for name, value in pairs]
+  duplicates = set(name for name in names if names.count(name) > 1)
+  if duplicates:
+    raise ValueError('duplicate names %s' % sorted(duplicates))
+  return dict(pairs)
+
+# The problems of JSON statistics and their epochs, if any
+def check_json(stats):
+  try:
+    final = json.load(open(stats), object_pairs_hook=unique_object)
+    sums = {}
+    for line in open(stats + '.epochs'):
+      epoch = json.loads(line, object_pairs_hook=unique_object)
+      for name, delta in epoch.items():
+        if name not in ('epoch', 'tick') and delta is not None:
+          sums[name] = sums.get(name, 0) + delta
+  except ValueError as e:
+    return str(e)
+  for name, value in final.items():
+    if value is not None and abs(sums.get(name, 0) - value) > 1e-6 * max(1, abs(value)):
+      return '%s adds up to %s in the epochs, but is %s' % (name, sums.get(name, 0), value)
+  return None
+
+def main():
+  tmp = tempfile.mkdtemp()
+  failed = 0
+  try:
+    cpu, dram = write_traces(tmp)
+    cases = [
+      ('cpu', 'cpu', [cpu], ()),
+      ('dram', 'dram', [dram], ()),
+      ('2-core', 'cpu', [cpu, cpu], ('cache=all', 'stats_format=json')),
+    ]
+    for name, mode, traces, options in cases:
+      off = run(tmp, name, mode, traces, 'off', options)
+      on = run(tmp, name, mode, traces, 'on', options)
+      off_ticks = epoch_ticks(off)
+      on_ticks = epoch_ticks(on)
+      # all but the last, partial epoch end on a boundary
+      boundaries = all(b - a == EPOCH_CYCLES for a, b in zip(off_ticks[:-1], off_ticks[1:-1]))
+      if off_ticks != on_ticks or len(off_ticks) < 3 or not boundaries:
+        print('%s: FAILED, the epoch ticks are %s without and %s with skipping' %
+            (name, off_ticks[:5], on_ticks[:5]))
+        failed += 1
+        continue
+      problem = check_json(off) if 'stats_format=json' in options else None
+      if problem:
+        print('%s: FAILED, %s' % (name, problem))
+        failed += 1
+      else:
+        print('%s: %d epochs at the same ticks' % (name, len(off_ticks)))
+  finally:
+    shutil.rmtree(tmp)
+  sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+  main()
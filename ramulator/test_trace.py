@@ -0,0 +1,57 @@
+#!/usr/bin/python
+# Checks that an unfiltered CPU trace (with core caches) is rejected when a
+# request type is neither R nor W, whether it is garbage or the write-back
+# address of a filtered trace, and that a filtered trace (no core caches)
+# still takes write-back addresses. Plain text traces are checked with and
+# without the reader thread.
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+TRACES = {
+  'ok': '3 0x1000\n2 0x2000 W\n5 0x3000 R\n',
+  'bad': '3 0x1000\n2 0x2000 X\n',
+  'writeback': '3 0x1000\n2 0x2000 0x4000\n',
+}
+
+# trace, cache, whether the simulation should succeed
+CASES = [
+  ('ok', 'all', True),
+  ('ok', 'no', True),
+  ('bad', 'all', False),
+  ('bad', 'no', False),
+  ('writeback', 'all', False),
+  ('writeback', 'no', True),
+]
+
+def run(tmp, trace, cache, reader_thread):
+  devnull = open(os.devnull, 'w')
+  return subprocess.call(['./ramulator', 'configs/DDR3-config.cfg', '--mode=cpu',
+      '--stats', os.path.join(tmp, 'trace.stats'), '-t', os.path.join(tmp, trace),
+      '-p', 'warmup_insts=0', '-p', 'cache=' + cache,
+      '-p', 'trace_reader_thread=' + reader_thread],
+      stdout=devnull, stderr=devnull) == 0
+
+def main():
+  tmp = tempfile.mkdtemp()
+  failed = 0
+  try:
+    for name, text in TRACES.items():
+      with open(os.path.join(tmp, name), 'w') as f:
+        f.write(text)
+    for trace, cache, ok in CASES:
+      for reader_thread in ('off', 'on'):
+        if run(tmp, trace, cache, reader_thread) != ok:
+          print('%s trace, cache=%s, trace_reader_thread=%s: FAILED, expected %s' %
+              (trace, cache, reader_thread, 'success' if ok else 'an error'))
+          failed += 1
+  finally:
+    shutil.rmtree(tmp)
+  print('%d of %d cases failed' % (failed, 2 * len(CASES)))
+  sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,81 @@
+#!/usr/bin/python
+
+# Converts a text trace into the binary trace format that ramulator reads
+# through mmap (see BinaryTraceRecord in src/Processor.h). Binary traces are
+# detected automatically and can be passed with -t like text traces.
+#
+# Usage: trace2bin.py <cpu|dram> <text-trace or - for stdin> <binary-trace>
+#   e.g. zcat workloads/401.bzip2.gz | ./trace2bin.py cpu - 401.bzip2.bin
+
+import struct
+import sys
+
+MAGIC = b'RAMTRACE'
+VERSION = 1
+
+WRITE = 1
+HAS_WRITEBACK = 2
+
+header = struct.Struct('<8sII')
+record = struct.Struct('<IIQQ')
+
+
+def parse_int(tok):
+  # same as std::stoul(tok, nullptr, 0)
+  if tok[:2] in ('0x', '0X'):
+    return int(tok, 16)
+  if len(tok) > 1 and tok[0] == '0':
+    return int(tok, 8)
+  return int(tok)
+
+
+def parse_cpu(tokens):
+  # <num-cpuinst> <addr> [<addr-writeback> | R | W]
+  bubbles = int(tokens[0])
+  addr = parse_int(tokens[1])
+  flags = 0
+  wb_addr = 0
+  if len(tokens) > 2:
+    if tokens[2][0] == 'W':
+      flags |= WRITE
+    elif tokens[2][0] != 'R':
+      flags |= HAS_WRITEBACK
+      wb_addr = parse_int(tokens[2])
+  return bubbles, flags, addr, wb_addr
+
+
+def parse_dram(tokens):
+  # <hex-addr> [R | W]
+  addr = int(tokens[0], 16)
+  flags = WRITE if len(tokens) > 1 and tokens[1][0] == 'W' else 0
+  return 0, flags, addr, 0
+
+
+def main():
+  if len(sys.argv) != 4 or sys.argv[1] not in ('cpu', 'dram'):
+    sys.stderr.write('Usage: %s <cpu|dram> <text-trace> <binary-trace>\n' % sys.argv[0])
+    sys.exit(1)
+
+  parse = parse_cpu if sys.argv[1] == 'cpu' else parse_dram
+  fin = sys.stdin if sys.argv[2] == '-' else open(sys.argv[2])
+
+  num = 0
+  with open(sys.argv[3], 'wb') as fout:
+    fout.write(header.pack(MAGIC, VERSION, 0))
+    buf = []
+    for line in fin:
+      tokens = line.split()
+      if not tokens:
+        break  # ramulator stops at the first empty line as well
+      buf.append(record.pack(*parse(tokens)))
+      if len(buf) == 65536:
+        fout.write(b''.join(buf))
+        buf = []
+      num += 1
+    fout.write(b''.join(buf))
+
+  print('%d records written to %s' % (num, sys.argv[3]))
+
+
+if __name__ == '__main__':
+  main()